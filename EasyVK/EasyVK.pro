@@ -1,8 +1,13 @@
 QT -= gui
 
-CONFIG += c++11 console
+# 需要C++17（如std::make_unique）；Qt 5.9的qmake只认c++1z，较新的Qt认c++17
+CONFIG += c++17 c++1z console
 CONFIG -= app_bundle
 
+# CopyStridedElements(...)的AVX2实现，要求运行的CPU支持AVX2
+win32-msvc*: QMAKE_CXXFLAGS += /arch:AVX2
+else: QMAKE_CXXFLAGS += -mavx2
+
 # You can make your code fail to compile if it uses deprecated APIs.
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
@@ -12,6 +17,7 @@ SOURCES += \
         Examples/Samples2DCompute.cpp \
         VKBase+.cpp \
         VKBase.cpp \
+        VKMesh.cpp \
         main.cpp
 
 # Default rules for deployment.
@@ -84,13 +90,16 @@ HEADERS += \
     GlfwGeneral.h \
     VKBase+.h \
     VKBase.h \
-    VKFormat.h
+    VKFormat.h \
+    VKLayout.h \
+    VKMesh.h
 
 DISTFILES += \
     shader/FirstTriangle.frag.shader \
     shader/FirstTriangle.vert.shader \
     shader/PushConstant.vert.shader \
     shader/Samples2D.comp \
+    shader/ScatterUpdate.comp \
     shader/UniformAndShaderStorage.vert.shader \
     shader/UniformBuffer.vert.shader \
     shader/VertexBuffer.frag.shader \
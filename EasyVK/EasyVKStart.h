@@ -7,14 +7,19 @@
 #include <sstream>
 #include <vector>
 #include <stack>
+#include <deque>
 #include <map>
 #include <unordered_map>
 #include <memory>
 #include <functional>
 #include <chrono>
 #include <numeric>
+#include <random>
+#include <algorithm>
 #include <cassert>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include <thread>
 
 //qt
@@ -76,8 +76,35 @@ namespace easyVulkan {
             return;
         }
         qDebug()<<QString("%1 load success!").arg(imagePath);
-        //将图像数据存入暂存缓冲区
-        stagingBuffer::BufferData_MainThread(pImageData.get(), FormatInfo(imageFormat).sizePerPixel * imageExtent.width * imageExtent.height);
+        //经当前线程的stagingRing将图像数据上传到设备本地图像，大图像会被分块，暂存区的占用不随图像大小增长
+        VkImageCreateInfo imageCreateInfo = {};
+        imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;//2D图像
+        imageCreateInfo.format = imageFormat;
+        imageCreateInfo.extent = VkExtent3D{imageExtent.width,imageExtent.height,1};
+        imageCreateInfo.mipLevels = 1;
+        imageCreateInfo.arrayLayers = 1;
+        imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT; //按1个字节采样
+        imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        imageMemory image_memory(imageCreateInfo,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        VkBufferImageCopy region_copy{};
+        region_copy.imageOffset = VkOffset3D{};//图像数据被拷入图像的起始位置,所以也是0
+        region_copy.imageSubresource = VkImageSubresourceLayers{VK_IMAGE_ASPECT_COLOR_BIT,0,0,1};
+        region_copy.imageExtent = imageCreateInfo.extent;
+        uploadBatch batch;
+        if(!batch.CopyBufferToImage(image_memory.Image(),
+                                    imageFormat,
+                                    pImageData.get(),
+                                    FormatInfo(imageFormat).sizePerPixel * imageExtent.width * imageExtent.height,
+                                    region_copy,
+                                    imageOperation::imageMemoryBarrierParameterPack(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, //过去管线起点开始
+                                                                                    0,
+                                                                                    VK_IMAGE_LAYOUT_UNDEFINED),
+                                    imageOperation::imageMemoryBarrierParameterPack(VK_PIPELINE_STAGE_TRANSFER_BIT,//将来作为blit的源
+                                                                                    VK_ACCESS_TRANSFER_READ_BIT,
+                                                                                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)))
+            return;
+        //上传与之后的blit提交到同一图形队列，按提交顺序执行，无需在CPU侧等待
+        batch.Submit();
 
 
         /*创建渲染循环*/
@@ -94,101 +121,28 @@ namespace easyVulkan {
         //2.录制命令(预留)
         command_buffer.Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 
-        //2.1 启动传输命令前需要确认图像是否与交换链图像参数一致
+        //2.1 图像与交换链图像尺寸不一致时blit负责缩放，一致时blit等同于逐texel拷贝（格式不一致时还负责格式转换）
         VkExtent2D swapchainImageSize =  graphicsBase::Base().SwapchainCreateInfo().imageExtent;
-        bool blit = imageExtent.width != swapchainImageSize.width ||
-                    imageExtent.height != swapchainImageSize.height ||
-                    imageFormat != graphicsBase::Base().SwapchainCreateInfo().imageFormat;
-        imageMemory image_memory;
-        if(blit){//加载图像参数与交换链参数不一致，需要blit
-            //尝试创建能与buffer混叠的暂存图像 -- 创建出来的图像layout是VK_IMAGE_LAYOUT_PREINITIALIZED -- 告诉GPU不可以在layout转换时丢弃数据。layout是UNDEFINED --- 可以丢弃
-            VkImage image = stagingBuffer::AliasedImage2d_MainThread(imageFormat, imageExtent);
-            if(image){
-                //增加图像内存屏障 -- 确保image构造完成
-                VkImageMemoryBarrier imageMemoryBarrier = {};
-                imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                imageMemoryBarrier.pNext = nullptr;
-                imageMemoryBarrier.srcAccessMask = 0;//过去没有操作 -- 因为是从TOP_PIPE阶段开始的
-                imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;//将来图像需要给到transfer阶段做blit写入的
-                imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;//没有队列族转移
-                imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;//没有队列族转移
-                imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;//创建出来就是这个layout
-                imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;//VkImage是作为源输入给到blit，必须为VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
-                imageMemoryBarrier.image = image;//指定哪一张图像需要内存屏障
-                imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;//RGBA纹理通道
-                imageMemoryBarrier.subresourceRange.baseMipLevel = 0;//默认层级
-                imageMemoryBarrier.subresourceRange.levelCount = 1;
-                imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
-                imageMemoryBarrier.subresourceRange.layerCount = 1;
-                vkCmdPipelineBarrier(command_buffer,VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,VK_PIPELINE_STAGE_TRANSFER_BIT,0,0,nullptr,0,nullptr,1,&imageMemoryBarrier);
-            }
-            else{
-                //用buffer创建混叠图像失败后，手动创建一张图像
-                VkImageCreateInfo imageCreateInfo = {};
-                imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;//2D图像
-                imageCreateInfo.format = imageFormat;
-                imageCreateInfo.extent = VkExtent3D{imageExtent.width,imageExtent.height,1};
-                imageCreateInfo.mipLevels = 1;
-                imageCreateInfo.arrayLayers = 1;
-                imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT; //按1个字节采样
-                imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-                image_memory.Create(imageCreateInfo,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);//内存已经在VKBuffer里了，VkBuffer属于GPU内存 -- 所以使用local
-
-                //image memory创建完成之后，需要创建vkImage -- 此时数据在VkBuffer内，新建的ImageMemory是空的，所以将buffer拷贝到image
-                VkBufferImageCopy region_copy{};
-                region_copy.bufferOffset = 0;region_copy.bufferRowLength = 0;region_copy.bufferImageHeight = 0;//buffer从起始位置紧密排列
-                region_copy.imageOffset = VkOffset3D{};//图像数据被拷入交换链图像的起始位置,所以也是0
-                region_copy.imageSubresource = VkImageSubresourceLayers{VK_IMAGE_ASPECT_COLOR_BIT,0,0,1};
-                region_copy.imageExtent = imageCreateInfo.extent;
-
-                imageOperation::CmdCopyBufferToImage(command_buffer,
-                                                     stagingBuffer::Buffer_MainThread(),
-                                                     image_memory.Image(),
-                                                     region_copy,
-                                                     imageOperation::imageMemoryBarrierParameterPack(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, //过去管线起点开始
-                                                                                                     0,
-                                                                                                     VK_IMAGE_LAYOUT_UNDEFINED),
-                                                     imageOperation::imageMemoryBarrierParameterPack(VK_PIPELINE_STAGE_TRANSFER_BIT,//将来传输命令
-                                                                                                     0,
-                                                                                                     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL));
-                image = image_memory.Image();
-            }
-            //得到VkImage之后,开始blit操作 region描述的内容可以实现缩放、翻转
-            VkImageBlit region_blit = {
-                { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
-                { {}, { int32_t(imageExtent.width), int32_t(imageExtent.height), 1 } },
-                { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
-                { {}, { int32_t(swapchainImageSize.width), int32_t(swapchainImageSize.height), 1 } }
-            };
-            imageOperation::CmdBlitImage(command_buffer,
-                                         image, //图像layout:VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
-                                         graphicsBase::Base().SwapchainImage(graphicsBase::Base().CurrentImageIndex()),//图像layout:VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
-                                         region_blit,
-                                         imageOperation::imageMemoryBarrierParameterPack(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                                                                                         0,
-                                                                                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL),
-                                         imageOperation::imageMemoryBarrierParameterPack(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-                                                                                         0,
-                                                                                         VK_IMAGE_LAYOUT_PRESENT_SRC_KHR));
-        }
-        else{//参数一致，直接copy
-            VkBufferImageCopy region_copy{};
-            region_copy.bufferOffset = 0;region_copy.bufferRowLength = 0;region_copy.bufferImageHeight = 0;//buffer从起始位置紧密排列
-            region_copy.imageOffset = VkOffset3D{};//图像数据被拷入交换链图像的起始位置,所以也是0
-
-            region_copy.imageSubresource = VkImageSubresourceLayers{VK_IMAGE_ASPECT_COLOR_BIT,0,0,1};
-            region_copy.imageExtent = VkExtent3D{imageExtent.width,imageExtent.height,1};
-            imageOperation::CmdCopyBufferToImage(command_buffer,
-                                                 stagingBuffer::Buffer_MainThread(),
-                                                 graphicsBase::Base().SwapchainImage(graphicsBase::Base().CurrentImageIndex()),
-                                                 region_copy,
-                                                 imageOperation::imageMemoryBarrierParameterPack(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, //不需要等待任何已有的GPU操作(同步起点)
-                                                                                                 0,
-                                                                                                 VK_IMAGE_LAYOUT_UNDEFINED),
-                                                 imageOperation::imageMemoryBarrierParameterPack(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,//等待之前所有的GPU操作结束(同步终点)
-                                                                                                 0,
-                                                                                                 VK_IMAGE_LAYOUT_PRESENT_SRC_KHR));
-        }
+        bool scaled = imageExtent.width != swapchainImageSize.width ||
+                      imageExtent.height != swapchainImageSize.height;
+        //region描述的内容可以实现缩放、翻转
+        VkImageBlit region_blit = {
+            { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+            { {}, { int32_t(imageExtent.width), int32_t(imageExtent.height), 1 } },
+            { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+            { {}, { int32_t(swapchainImageSize.width), int32_t(swapchainImageSize.height), 1 } }
+        };
+        imageOperation::CmdBlitImage(command_buffer,
+                                     image_memory.Image(), //图像layout:VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                     graphicsBase::Base().SwapchainImage(graphicsBase::Base().CurrentImageIndex()),//图像layout:VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+                                     region_blit,
+                                     imageOperation::imageMemoryBarrierParameterPack(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                                                                     0,
+                                                                                     VK_IMAGE_LAYOUT_UNDEFINED),//交换链图像将被整个覆盖，无需保留原有内容
+                                     imageOperation::imageMemoryBarrierParameterPack(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                                                                     0,
+                                                                                     VK_IMAGE_LAYOUT_PRESENT_SRC_KHR),
+                                     scaled ? VK_FILTER_LINEAR : VK_FILTER_NEAREST);
 
         command_buffer.End();
 
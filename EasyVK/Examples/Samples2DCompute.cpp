@@ -87,9 +87,6 @@ void Samples2DCmp::initResource(const QString &ImagePath)
         return;
     }
 
-    //将图像数据存入暂存缓冲区
-    stagingBuffer::BufferData_MainThread(pImageData.get(), FormatInfo(imageFormat).sizePerPixel * imageExtent.width * imageExtent.height);
-
     //创建能被着色器读取的Image
     VkImageCreateInfo imageCreateInfo = {};
     imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;//2D图像
@@ -103,6 +100,25 @@ void Samples2DCmp::initResource(const QString &ImagePath)
     //创建源图像视图 -- imageView并不关心image是否有数据，只是定义了image的访问方式
     image_view_src.Create(image_memory_src.Image(),VK_IMAGE_VIEW_TYPE_2D,VK_FORMAT_R8G8B8A8_UNORM,VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
 
+    //将图像数据上传到源图像，只需上传一次，大图像会被分块，暂存区的占用不随图像大小增长
+    VkBufferImageCopy region_copy{};
+    region_copy.imageOffset = VkOffset3D{};
+    region_copy.imageSubresource = VkImageSubresourceLayers{VK_IMAGE_ASPECT_COLOR_BIT,0,0,1};
+    region_copy.imageExtent = VkExtent3D{imageExtent.width,imageExtent.height,1};
+    uploadBatch batch;
+    batch.CopyBufferToImage(image_memory_src.Image(),
+                            imageFormat,
+                            pImageData.get(),
+                            FormatInfo(imageFormat).sizePerPixel * imageExtent.width * imageExtent.height,
+                            region_copy,
+                            imageOperation::imageMemoryBarrierParameterPack(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, //过去管线起点开始
+                                                                            0,
+                                                                            VK_IMAGE_LAYOUT_UNDEFINED),
+                            imageOperation::imageMemoryBarrierParameterPack(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,//将来计算着色器读取
+                                                                            VK_ACCESS_SHADER_READ_BIT,
+                                                                            VK_IMAGE_LAYOUT_GENERAL));
+    batch.Submit().Wait();
+
 
     //创建目标图像,用于存储计算着色器输出的结果
     imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;//2D图像
@@ -128,29 +144,19 @@ void Samples2DCmp::initResource(const QString &ImagePath)
     dstImageDescInfo.imageView = image_view_dst;
     dstImageDescInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
     descriptorSet_compute.write(dstImageDescInfo,VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,1);
+
+    //回读计算结果，3个槽，结果晚一至两帧到达
+    readback_ring.Create(FormatInfo(imageFormat).sizePerPixel * imageExtent.width * imageExtent.height, 3);
 }
 
 void Samples2DCmp::runDispatch(const commandBuffer& command_buffer)
 {
-    VkBufferImageCopy region_copy{};
-    region_copy.bufferOffset = 0;region_copy.bufferRowLength = 0;region_copy.bufferImageHeight = 0;//buffer从起始位置紧密排列
-    region_copy.imageOffset = VkOffset3D{};//图像数据被拷入交换链图像的起始位置,所以也是0
-    region_copy.imageSubresource = VkImageSubresourceLayers{VK_IMAGE_ASPECT_COLOR_BIT,0,0,1};
-    region_copy.imageExtent = VkExtent3D{imageExtent.width,imageExtent.height,1};
+    //源图像已在initResource(...)中上传，处于VK_IMAGE_LAYOUT_GENERAL
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout_compute, 0, 1, descriptorSet_compute.Address(), 0, nullptr);
+    vkCmdDispatch(command_buffer, (imageExtent.width + 15) / 16, (imageExtent.height + 15) / 16, 1);
 
-    //使用图像内存屏障将buffer拷贝到image
-    imageOperation::CmdCopyBufferToImage(command_buffer,
-                                         stagingBuffer::Buffer_MainThread(),
-                                         image_memory_src.Image(),
-                                         region_copy,
-                                         imageOperation::imageMemoryBarrierParameterPack(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, //过去管线起点开始
-                                                                                         0,
-                                                                                         VK_IMAGE_LAYOUT_UNDEFINED),
-                                         imageOperation::imageMemoryBarrierParameterPack(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,//将来传输命令
-                                                                                         0,
-                                                                                         VK_IMAGE_LAYOUT_GENERAL));
-
-    //增加图像内存屏障 -- 确保image构造完成
+    //增加图像内存屏障 -- 确保计算着色器写入完成后再blit
     VkImageMemoryBarrier imageMemoryBarrier = {};
     imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     imageMemoryBarrier.pNext = nullptr;
@@ -168,10 +174,6 @@ void Samples2DCmp::runDispatch(const commandBuffer& command_buffer)
     imageMemoryBarrier.subresourceRange.layerCount = 1;
     vkCmdPipelineBarrier(command_buffer,VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,VK_PIPELINE_STAGE_TRANSFER_BIT,0,0,nullptr,0,nullptr,1,&imageMemoryBarrier);
 
-    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_compute);
-    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout_compute, 0, 1, descriptorSet_compute.Address(), 0, nullptr);
-    vkCmdDispatch(command_buffer, (imageExtent.width + 15) / 16, (imageExtent.height + 15) / 16, 1);
-
     //得到VkImage之后,开始blit操作 region描述的内容可以实现缩放、翻转
     VkExtent2D swapchainImageSize =  graphicsBase::Base().SwapchainCreateInfo().imageExtent;
     VkImageBlit region_blit = {
@@ -186,8 +188,34 @@ void Samples2DCmp::runDispatch(const commandBuffer& command_buffer)
                                  region_blit,
                                  imageOperation::imageMemoryBarrierParameterPack(VK_PIPELINE_STAGE_TRANSFER_BIT,
                                                                                  0,
-                                                                                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL),
+                                                                                 VK_IMAGE_LAYOUT_UNDEFINED),//交换链图像将被整个覆盖，无需保留原有内容
                                  imageOperation::imageMemoryBarrierParameterPack(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
                                                                                  0,
                                                                                  VK_IMAGE_LAYOUT_PRESENT_SRC_KHR));
+
+    //blit读取完毕后，将目标图像转回VK_IMAGE_LAYOUT_GENERAL，供下一帧的计算着色器写入
+    imageMemoryBarrier.srcAccessMask = 0;
+    imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    vkCmdPipelineBarrier(command_buffer,VK_PIPELINE_STAGE_TRANSFER_BIT,VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,0,0,nullptr,0,nullptr,1,&imageMemoryBarrier);
+}
+
+bool Samples2DCmp::readbackResult(vulkan::readbackRing::callback_t callback)
+{
+    VkBufferImageCopy region_copy{};
+    region_copy.imageOffset = VkOffset3D{};
+    region_copy.imageSubresource = VkImageSubresourceLayers{VK_IMAGE_ASPECT_COLOR_BIT,0,0,1};
+    region_copy.imageExtent = VkExtent3D{imageExtent.width,imageExtent.height,1};
+    //拷贝在本帧的命令之后执行，拷贝完成后转回VK_IMAGE_LAYOUT_GENERAL，下一帧的计算着色器须等待拷贝读取完毕再写入
+    return readback_ring.CopyImage(image_memory_dst.Image(),
+                                   FormatInfo(VK_FORMAT_R8G8B8A8_UNORM).sizePerPixel * imageExtent.width * imageExtent.height,
+                                   region_copy,
+                                   imageOperation::imageMemoryBarrierParameterPack(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                                                                   0,
+                                                                                   VK_IMAGE_LAYOUT_GENERAL),
+                                   imageOperation::imageMemoryBarrierParameterPack(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                                                                   VK_ACCESS_SHADER_WRITE_BIT,
+                                                                                   VK_IMAGE_LAYOUT_GENERAL),
+                                   std::move(callback));
 }
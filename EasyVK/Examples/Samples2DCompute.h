@@ -12,6 +12,10 @@ public:
 
     void runDispatch(const vulkan::commandBuffer& command_buffer);
 
+    //在runDispatch(...)所在的命令缓冲区提交后调用，将计算结果异步拷贝回CPU，在之后的帧中交付给callback
+    //回读槽都在使用中时返回false，本帧的结果被跳过
+    bool readbackResult(vulkan::readbackRing::callback_t callback);
+
 private:
     /*管线资源*/
     vulkan::descriptorSetLayout descriptorSetLayout_compute; //描述符布局
@@ -26,6 +30,9 @@ private:
     vulkan::imageView image_view_src;
     vulkan::imageMemory image_memory_dst;
     vulkan::imageView image_view_dst;
+
+    /*回读资源*/
+    vulkan::readbackRing readback_ring;
 };
 
 #endif // SAMPLES2DCOMPUTE_H
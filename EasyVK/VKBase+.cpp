@@ -1,4 +1,12 @@
 #include "VKBase+.h"
+//CopyStridedElements(...)使用的SIMD指令集，AVX2须在编译时开启（-mavx2或/arch:AVX2）
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define EASYVK_USE_SSE2
+#endif
 
 using namespace vulkan;
 
@@ -12,6 +20,26 @@ formatInfo FormatInfo(VkFormat format)
 #endif
     return formatInfos_v1_0[format];
 }
+formatInfo::numeric FormatNumeric(VkFormat format)
+{
+    //VK 1.0中，分量大小相同的格式按UNORM、SNORM、USCALED、SSCALED、UINT、SINT、SRGB/SFLOAT的顺序排列
+    static constexpr formatInfo::numeric numerics_8Bit[] = { formatInfo::unorm, formatInfo::snorm, formatInfo::uscaled, formatInfo::sscaled, formatInfo::uinteger, formatInfo::sinteger, formatInfo::srgb };
+    static constexpr formatInfo::numeric numerics_16Bit[] = { formatInfo::unorm, formatInfo::snorm, formatInfo::uscaled, formatInfo::sscaled, formatInfo::uinteger, formatInfo::sinteger, formatInfo::sfloat };
+    static constexpr formatInfo::numeric numerics_32Bit[] = { formatInfo::uinteger, formatInfo::sinteger, formatInfo::sfloat };
+    if (format >= VK_FORMAT_R4G4_UNORM_PACK8 && format <= VK_FORMAT_A1R5G5B5_UNORM_PACK16)
+        return formatInfo::unorm;
+    if (format >= VK_FORMAT_R8_UNORM && format <= VK_FORMAT_A8B8G8R8_SRGB_PACK32)
+        return numerics_8Bit[(format - VK_FORMAT_R8_UNORM) % 7];
+    if (format >= VK_FORMAT_A2R10G10B10_UNORM_PACK32 && format <= VK_FORMAT_A2B10G10R10_SINT_PACK32)
+        return numerics_8Bit[(format - VK_FORMAT_A2R10G10B10_UNORM_PACK32) % 6];
+    if (format >= VK_FORMAT_R16_UNORM && format <= VK_FORMAT_R16G16B16A16_SFLOAT)
+        return numerics_16Bit[(format - VK_FORMAT_R16_UNORM) % 7];
+    if (format >= VK_FORMAT_R32_UINT && format <= VK_FORMAT_R64G64B64A64_SFLOAT)
+        return numerics_32Bit[(format - VK_FORMAT_R32_UINT) % 3];
+    if (format == VK_FORMAT_B10G11R11_UFLOAT_PACK32 || format == VK_FORMAT_E5B9G9R9_UFLOAT_PACK32)
+        return formatInfo::ufloat;
+    return formatInfo::otherNumeric;
+}
 VkFormat Corresponding16BitFloatFormat(VkFormat format_32BitFloat)
 {
     switch (format_32BitFloat) {
@@ -32,6 +60,111 @@ const VkFormatProperties &FormatProperties(VkFormat format)
     return graphicsBase::Plus().FormatProperties(format);
 }
 
+template<size_t elementSize>
+static void CopyStridedElements_Fixed(uint8_t* pDst, size_t stride_dst, const uint8_t* pSrc, size_t stride_src, size_t begin, size_t elementCount) {
+    //元素大小为编译期常量，memcpy会被编译为若干条mov指令
+    for (size_t i = begin; i < elementCount; i++)
+        memcpy(pDst + stride_dst * i, pSrc + stride_src * i, elementSize);
+}
+#if defined(EASYVK_USE_SSE2)
+template<>
+void CopyStridedElements_Fixed<16>(uint8_t* pDst, size_t stride_dst, const uint8_t* pSrc, size_t stride_src, size_t begin, size_t elementCount) {
+    for (size_t i = begin; i < elementCount; i++)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + stride_dst * i), _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + stride_src * i)));
+}
+#endif
+#if defined(__AVX2__)
+template<>
+void CopyStridedElements_Fixed<32>(uint8_t* pDst, size_t stride_dst, const uint8_t* pSrc, size_t stride_src, size_t begin, size_t elementCount) {
+    for (size_t i = begin; i < elementCount; i++)
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + stride_dst * i), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + stride_src * i)));
+}
+#endif
+
+void CopyStridedElements(void* pData_dst, size_t stride_dst, const void* pData_src, size_t stride_src, size_t elementSize, size_t elementCount)
+{
+    uint8_t* pDst = static_cast<uint8_t*>(pData_dst);
+    const uint8_t* pSrc = static_cast<const uint8_t*>(pData_src);
+    //两侧都紧密排列
+    if (stride_dst == elementSize && stride_src == elementSize) {
+        memcpy(pDst, pSrc, elementSize * elementCount);
+        return;
+    }
+    size_t i = 0;
+#if defined(__AVX2__)
+    //4或8字节的元素打包到连续内存时，用gather指令一次读取8个或4个元素，索引为32位，须保证7 * stride_src不溢出
+    if (stride_dst == elementSize && stride_src <= INT32_MAX / 8) {
+        if (elementSize == 4) {
+            __m256i indices = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(int32_t(stride_src)));
+            for (; i + 8 <= elementCount; i += 8)
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + 4 * i),
+                    _mm256_i32gather_epi32(reinterpret_cast<const int*>(pSrc + stride_src * i), indices, 1));
+        }
+        else if (elementSize == 8) {
+            __m128i indices = _mm_mullo_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(int32_t(stride_src)));
+            for (; i + 4 <= elementCount; i += 4)
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + 8 * i),
+                    _mm256_i32gather_epi64(reinterpret_cast<const long long*>(pSrc + stride_src * i), indices, 1));
+        }
+    }
+#endif
+#if defined(EASYVK_USE_SSE2)
+    //12字节的元素打包到连续内存时，每次读取4个元素（各16字节，多读的4字节属于下一个元素或其后的空隙），重排为3个16字节写入
+    //最后一个元素不以这种方式读取，以免越过源数据的末尾
+    if (elementSize == 12 && stride_dst == 12)
+        for (; i + 4 < elementCount; i += 4) {
+            const uint8_t* pSrc_i = pSrc + stride_src * i;
+            __m128 a = _mm_loadu_ps(reinterpret_cast<const float*>(pSrc_i));
+            __m128 b = _mm_loadu_ps(reinterpret_cast<const float*>(pSrc_i + stride_src));
+            __m128 c = _mm_loadu_ps(reinterpret_cast<const float*>(pSrc_i + stride_src * 2));
+            __m128 d = _mm_loadu_ps(reinterpret_cast<const float*>(pSrc_i + stride_src * 3));
+            //|a0 a1 a2 b0|b1 b2 c0 c1|c2 d0 d1 d2|
+            __m128 a2b0 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 2, 2));
+            __m128 c2d0 = _mm_shuffle_ps(c, d, _MM_SHUFFLE(0, 0, 2, 2));
+            float* pDst_i = reinterpret_cast<float*>(pDst + 12 * i);
+            _mm_storeu_ps(pDst_i, _mm_shuffle_ps(a, a2b0, _MM_SHUFFLE(2, 0, 1, 0)));
+            _mm_storeu_ps(pDst_i + 4, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 0, 2, 1)));
+            _mm_storeu_ps(pDst_i + 8, _mm_shuffle_ps(c2d0, d, _MM_SHUFFLE(2, 1, 2, 0)));
+        }
+#endif
+    switch (elementSize) {
+    case 1: CopyStridedElements_Fixed<1>(pDst, stride_dst, pSrc, stride_src, i, elementCount); break;
+    case 2: CopyStridedElements_Fixed<2>(pDst, stride_dst, pSrc, stride_src, i, elementCount); break;
+    case 4: CopyStridedElements_Fixed<4>(pDst, stride_dst, pSrc, stride_src, i, elementCount); break;
+    case 8: CopyStridedElements_Fixed<8>(pDst, stride_dst, pSrc, stride_src, i, elementCount); break;
+    case 12: CopyStridedElements_Fixed<12>(pDst, stride_dst, pSrc, stride_src, i, elementCount); break;
+    case 16: CopyStridedElements_Fixed<16>(pDst, stride_dst, pSrc, stride_src, i, elementCount); break;
+    case 32: CopyStridedElements_Fixed<32>(pDst, stride_dst, pSrc, stride_src, i, elementCount); break;
+    default:
+        for (; i < elementCount; i++)
+            memcpy(pDst + stride_dst * i, pSrc + stride_src * i, elementSize);
+    }
+}
+
+//std140/std430布局的偏移、步长和大小均在编译期算出，这里按GLSL规范中的规则核对
+namespace {
+    struct particle { glm::vec3 position; float mass; glm::vec2 velocity; };
+    using particleLayout = glslStruct<std430, GlslMember(particle, position), GlslMember(particle, mass), GlslMember(particle, velocity)>;
+    static_assert(particleLayout::Offset(1) == 12 && particleLayout::Offset(2) == 16 && particleLayout::size == 32, "");
+    static_assert(!particleLayout::IsCppCompatible(sizeof(particle)), "");
+    struct vertex { glm::vec4 position; glm::vec4 color; };
+    static_assert(glslStruct<std140, GlslMember(vertex, position), GlslMember(vertex, color)>::IsCppCompatible(sizeof(vertex)), "");
+    //vec3后的标量紧跟其后，标量后的vec3对齐到16
+    static_assert(glslStruct<std430, glslMember<float>, glslMember<glm::vec3>>::Offset(1) == 16, "");
+    static_assert(glslStruct<std430, glslMember<glm::vec2>, glslMember<float>>::size == 16, "");
+    //数组和矩阵：std140下步长向上凑整到16
+    static_assert(glslTypeLayout<std430, float[4]>::stride == 4 && glslTypeLayout<std430, float[4]>::size == 16, "");
+    static_assert(glslTypeLayout<std140, float[4]>::stride == 16 && glslTypeLayout<std140, float[4]>::size == 64, "");
+    static_assert(glslTypeLayout<std430, glm::mat2>::size == 16 && glslTypeLayout<std140, glm::mat2>::size == 32, "");
+    static_assert(glslTypeLayout<std430, glm::mat3>::stride == 16 && glslTypeLayout<std430, glm::mat3>::size == 48, "");
+    static_assert(glslTypeLayout<std140, glm::mat4>::size == 64, "");
+    //嵌套的结构体：std140下对齐和大小向上凑整到16
+    using innerStd140 = glslStruct<std140, glslMember<float>>;
+    using innerStd430 = glslStruct<std430, glslMember<float>>;
+    static_assert(innerStd140::size == 16 && glslStruct<std140, glslMember<float>, glslMember<float, 0, innerStd140>>::Offset(1) == 16, "");
+    static_assert(innerStd430::size == 4 && glslStruct<std430, glslMember<float>, glslMember<float, 0, innerStd430>>::size == 8, "");
+}
+
 
 graphicsBasePlus graphicsBasePlus::singleton;
 
@@ -44,6 +177,10 @@ graphicsBasePlus::graphicsBasePlus():
             singleton.commandPool_graphics.Create(graphicsBase::Base().QueueFamilyIndex_Graphics(), VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT),
             singleton.commandPool_graphics.AllocateBuffers(singleton.commandBuffer_transfer);
         }
+        if (graphicsBase::Base().HasDedicatedTransferQueue()){
+            singleton.commandPool_transfer.Create(graphicsBase::Base().QueueFamilyIndex_Transfer(), VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT),
+            singleton.commandPool_transfer.AllocateBuffers(singleton.commandBuffer_transferQueue);
+        }
         if (graphicsBase::Base().QueueFamilyIndex_Compute() != VK_QUEUE_FAMILY_IGNORED){
             singleton.commandPool_compute.Create(graphicsBase::Base().QueueFamilyIndex_Compute(), VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
         }
@@ -61,9 +198,11 @@ graphicsBasePlus::graphicsBasePlus():
     };
 
     auto CleanUp = [] {
+        singleton.ownershipAcquires.clear();
         singleton.commandPool_graphics.~commandPool();
         singleton.commandPool_presentation.~commandPool();
         singleton.commandPool_compute.~commandPool();
+        singleton.commandPool_transfer.~commandPool();
     };
     graphicsBase::Plus(singleton);
     graphicsBase::Base().AddCallback_CreateDevice(Initialize);
@@ -93,6 +232,58 @@ result_t graphicsBasePlus::ExecuteCommandBuffer_Graphics(VkCommandBuffer command
     return result;
 }
 
+result_t graphicsBasePlus::ExecuteCommandBuffer_Transfer(VkCommandBuffer commandBuffer, arrayRef<const VkBufferMemoryBarrier> acquireBarriers) const
+{
+    if (!graphicsBase::Base().HasDedicatedTransferQueue())
+        return ExecuteCommandBuffer_Graphics(commandBuffer);
+    if (!acquireBarriers.Count()){
+        fence f;
+        VkResult result = graphicsBase::Base().SubmitCommandBuffer_Transfer(commandBuffer, (VkSemaphore)VK_NULL_HANDLE, f);
+        if (!result)
+            f.Wait();
+        return result;
+    }
+    //最早的一次获取已完成时再用其命令缓冲区和信号量，否则新建一个
+    std::unique_ptr<ownershipAcquire> pAcquire;
+    if (ownershipAcquires.size() && ownershipAcquires.front()->fence_acquired.Status() == VK_SUCCESS)
+        pAcquire = std::move(ownershipAcquires.front()),
+        ownershipAcquires.pop_front(),
+        pAcquire->fence_acquired.Reset();
+    else
+        pAcquire = std::make_unique<ownershipAcquire>(),
+        commandPool_graphics.AllocateBuffers(pAcquire->command_buffer);
+    //在图形队列上获取所有权，srcAccessMask对获取所有权的屏障无意义，dstAccessMask覆盖之后的任何访问
+    std::vector<VkBufferMemoryBarrier> barriers(acquireBarriers.begin(), acquireBarriers.end());
+    for (auto& i : barriers)
+        i.srcAccessMask = 0,
+        i.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    pAcquire->command_buffer.Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    vkCmdPipelineBarrier(pAcquire->command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+        0, nullptr, uint32_t(barriers.size()), barriers.data(), 0, nullptr);
+    pAcquire->command_buffer.End();
+    fence fence_transferred;
+    if (VkResult result = graphicsBase::Base().SubmitCommandBuffer_Transfer(commandBuffer, pAcquire->semaphore_transferIsOver, fence_transferred)) {
+        commandPool_graphics.FreeBuffers(pAcquire->command_buffer);
+        return result;
+    }
+    VkPipelineStageFlags waitDstStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkSubmitInfo submitInfo = {};
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores = pAcquire->semaphore_transferIsOver.Address();
+    submitInfo.pWaitDstStageMask = &waitDstStage;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = pAcquire->command_buffer.Address();
+    //不等待获取完成：屏障的第二同步范围覆盖图形队列上之后的所有提交
+    VkResult result = graphicsBase::Base().SubmitCommandBuffer_Graphics(submitInfo, pAcquire->fence_acquired);
+    //commandBuffer和其读取的暂存区在传输完成后才能再用；提交失败时，信号量须在其被置位后才能随pAcquire销毁
+    fence_transferred.Wait();
+    if (result)
+        commandPool_graphics.FreeBuffers(pAcquire->command_buffer);
+    else
+        ownershipAcquires.push_back(std::move(pAcquire));
+    return result;
+}
+
 result_t graphicsBasePlus::AcquireImageOwnership_Presentation(VkSemaphore semaphore_renderingIsOver, VkSemaphore semaphore_ownershipIsTransfered, VkFence fence) const
 {
     if (VkResult result = commandBuffer_presentation.Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT)){
@@ -124,7 +315,11 @@ void stagingBuffer::Expand(VkDeviceSize size)
     VkBufferCreateInfo bufferCreateInfo = {};
     bufferCreateInfo.size = size;
     bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-    buffer_memory.Create(bufferCreateInfo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    //暂存缓冲区大小多变，且可能被用作混叠图像的内存，独占一块VkDeviceMemory
+    buffer_memory.ObjectType(graphicsBase::memoryObject_stagingBuffer);
+    buffer_memory.Create(bufferCreateInfo, memoryTypeSelector::upload, true);
+    //持久映射，每次上传数据只需memcpy(...)
+    buffer_memory.MapPersistently();
 }
 
 void stagingBuffer::Release()
@@ -215,34 +410,302 @@ VkImage stagingBuffer::AliasedImage2d(VkFormat format, VkExtent2D extent)
     if (subresourceLayout.size != imageDataSize){
         return VkImage(VK_NULL_HANDLE);
     }
-    aliasedImage.BindMemory(buffer_memory.Memory());
+    aliasedImage.BindMemory(buffer_memory.Memory(), buffer_memory.MemoryOffset());
     return aliasedImage;
 }
 
 
+stagingRing::stagingRing(VkDeviceSize size)
+{
+    Create(size);
+}
+
+stagingRing::threadRings::threadRings()
+{
+    //逻辑设备销毁前已WaitIdle()，可以直接释放
+    graphicsBase::Base().AddCallback_DestroyDevice([this] {
+        std::lock_guard<std::mutex> lock(mtx);
+        rings.clear();
+    });
+}
+
+void stagingRing::Recycle(bool wait)
+{
+    while (batches.size()) {
+        batch& oldest = batches.front();
+        if (oldest.pFence->Status() != VK_SUCCESS) {
+            if (!wait)
+                return;
+            oldest.pFence->Wait();
+        }
+        wait = false;
+        tail = oldest.end;
+        oldest.pFence->Reset();
+        freeFences.push_back(std::move(oldest.pFence));
+        batches.pop_front();
+    }
+}
+
+void stagingRing::Create(VkDeviceSize size)
+{
+    VkBufferCreateInfo bufferCreateInfo = {};
+    bufferCreateInfo.size = size;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    buffer_memory.ObjectType(graphicsBase::memoryObject_stagingBuffer);
+    false ||
+    buffer_memory.Create(bufferCreateInfo, memoryTypeSelector::upload, true) ||
+    buffer_memory.MapPersistently();
+    capacity = size;
+    head = tail = batchBegin = 0;
+}
+
+void* stagingRing::Allocate(VkDeviceSize size, VkDeviceSize& offset, VkDeviceSize alignment)
+{
+    if (size > capacity) {
+        qDebug("[ stagingRing ] ERROR\nRequested size exceeds the capacity!\nRequested: %llu bytes\n", (unsigned long long)size);
+        return nullptr;
+    }
+    while (true) {
+        VkDeviceSize position = head % capacity;
+        VkDeviceSize alignedPosition = (position + alignment - 1) / alignment * alignment;
+        VkDeviceSize newHead = head + alignedPosition - position + size;
+        //不跨越缓冲区末尾，放不下时从缓冲区开头分配
+        if (alignedPosition + size > capacity)
+            alignedPosition = 0,
+            newHead = head + capacity - position + size;
+        if (newHead - tail <= capacity) {
+            head = newHead;
+            offset = alignedPosition;
+            return static_cast<uint8_t*>(buffer_memory.MappedData()) + alignedPosition;
+        }
+        if (batches.empty()) {
+            qDebug("[ stagingRing ] ERROR\nThe current batch has used up the ring, call EndBatch() and submit it first!\n");
+            return nullptr;
+        }
+        Recycle(true);
+    }
+}
+
+VkDeviceSize stagingRing::BufferData(const void* pData_src, VkDeviceSize size, VkDeviceSize alignment)
+{
+    VkDeviceSize offset;
+    void* pData_dst = Allocate(size, offset, alignment);
+    if (!pData_dst)
+        return VK_WHOLE_SIZE;
+    memcpy(pData_dst, pData_src, size_t(size));
+    return offset;
+}
+
+VkFence stagingRing::EndBatch()
+{
+    //刷新本批次写入的区域，跨越缓冲区末尾时分两段，以一次vkFlushMappedMemoryRanges(...)刷新
+    if (head > batchBegin) {
+        VkDeviceSize begin = batchBegin % capacity;
+        if (head - batchBegin >= capacity)
+            buffer_memory.FlushMappedMemoryRange(capacity);
+        else if (begin + (head - batchBegin) <= capacity)
+            buffer_memory.FlushMappedMemoryRange(head - batchBegin, begin);
+        else {
+            mappedMemoryRangeBatch ranges;
+            ranges.Add(buffer_memory, capacity - begin, begin);
+            ranges.Add(buffer_memory, head % capacity);
+            ranges.Flush();
+        }
+    }
+    if (freeFences.empty())
+        freeFences.push_back(std::make_unique<fence>());
+    batches.push_back({ head, std::move(freeFences.back()) });
+    freeFences.pop_back();
+    batchBegin = head;
+    return *batches.back().pFence;
+}
+
+void stagingRing::WaitAll()
+{
+    while (batches.size())
+        Recycle(true);
+}
+
+bool stagingRing::IsComplete(VkDeviceSize position)
+{
+    Recycle(false);
+    return batches.empty() || batches.front().end > position;
+}
+
+void stagingRing::Wait(VkDeviceSize position)
+{
+    while (batches.size() && batches.front().end <= position)
+        Recycle(true);
+}
+
+stagingRing& stagingRing::ThisThread(VkDeviceSize defaultSize)
+{
+    //线程退出时析构，释放该线程的stagingRing
+    struct releaser {
+        bool active = false;
+        ~releaser() {
+            if (active)
+                stagingRing::ReleaseThisThread();
+        }
+    };
+    thread_local releaser releaser_thisThread;
+    threadRings& threadRings = ThreadRings();
+    std::lock_guard<std::mutex> lock(threadRings.mtx);
+    std::unique_ptr<stagingRing>& pRing = threadRings.rings[std::this_thread::get_id()];
+    if (!pRing)
+        pRing = std::make_unique<stagingRing>(defaultSize),
+        releaser_thisThread.active = true;
+    return *pRing;
+}
+
+void stagingRing::ReleaseThisThread()
+{
+    threadRings& threadRings = ThreadRings();
+    //在锁内等待和销毁，以免与逻辑设备销毁时的清空同时进行；逻辑设备已销毁时表中已没有该线程的stagingRing
+    std::lock_guard<std::mutex> lock(threadRings.mtx);
+    auto iterator = threadRings.rings.find(std::this_thread::get_id());
+    if (iterator == threadRings.rings.end())
+        return;
+    //该线程提交的批次可能仍在执行
+    iterator->second->WaitAll();
+    threadRings.rings.erase(iterator);
+}
+
 deviceLocalBuffer::deviceLocalBuffer(VkDeviceSize size, VkBufferUsageFlags desiredUsages_Without_transfer_dst)
 {
    Create(size, desiredUsages_Without_transfer_dst);
 }
 
-void deviceLocalBuffer::Create(VkDeviceSize size, VkBufferUsageFlags desiredUsages_Without_transfer_dst)
+result_t deviceLocalBuffer::Create(VkDeviceSize size, VkBufferUsageFlags desiredUsages_Without_transfer_dst)
 {
+    this->size = size;
+    shadowData.reset();
+    dirtyRanges.clear();
+    if (desiredUsages_Without_transfer_dst & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT &&
+        !graphicsBase::Base().BufferDeviceAddressEnabled())
+        qDebug("[ deviceLocalBuffer ] ERROR\nThe bufferDeviceAddress feature is not enabled, VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT is ignored!\n"),
+        desiredUsages_Without_transfer_dst &= ~VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
     VkBufferCreateInfo bufferCreateInfo = {};
     bufferCreateInfo.size = size;
     bufferCreateInfo.usage = desiredUsages_Without_transfer_dst | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-    //短路执行，第一行的false||是为了对齐
-    false ||
-    buffer_memory.CreateBuffer(bufferCreateInfo) ||
-    buffer_memory.AllocateMemory(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && //&&运算符优先级高于||
-    buffer_memory.AllocateMemory(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) ||
-    buffer_memory.BindMemory();
+    //memoryTypeSelector::deviceLocal优先选择同时host visible的内存，没有则退而选择仅device local的内存
+    if (VkResult result = buffer_memory.Create(bufferCreateInfo, memoryTypeSelector::deviceLocal))
+        return result;
+    //分配到了host visible的内存（比如集显或开启了Resizable BAR），则持久映射，之后的TransferData(...)只需memcpy(...)
+    if (buffer_memory.MemoryProperties() & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        buffer_memory.MapPersistently();
+    return VK_SUCCESS;
 }
 
 void deviceLocalBuffer::Recreate(VkDeviceSize size, VkBufferUsageFlags desiredUsages_Without_transfer_dst)
 {
-    graphicsBase::Base().WaitIdle(); //deviceLocalBuffer封装的缓冲区可能会在每一帧中被频繁使用，重建它之前应确保物理设备没有在使用它
-    buffer_memory.~bufferMemory();
+    //deviceLocalBuffer封装的缓冲区可能会在每一帧中被频繁使用，不能立刻销毁，移入延迟销毁队列，等到GPU不再使用时再销毁
+    deferredDestructionQueue::Get().Push(buffer_memory);
+    std::unique_ptr<uint8_t[]> shadowData_old = std::move(shadowData);
+    VkDeviceSize size_old = this->size;
     Create(size, desiredUsages_Without_transfer_dst);
+    //新的缓冲区中没有数据，从影子副本重新上传保留下来的部分
+    if (shadowData_old && EnableShadow()) {
+        VkDeviceSize size_kept = std::min(size, size_old);
+        memcpy(shadowData.get(), shadowData_old.get(), size_t(size_kept));
+        MarkDirty(0, size_kept);
+    }
+}
+
+bool deviceLocalBuffer::EnableShadow()
+{
+    if (shadowData)
+        return true;
+    if (size % 4) {
+        qDebug("[ deviceLocalBuffer ] ERROR\nThe size of a buffer with a shadow copy must be a multiple of 4!\nSize: %llu\n", (unsigned long long)size);
+        return false;
+    }
+    shadowData.reset(new uint8_t[size_t(size)]());
+    return true;
+}
+
+bool deviceLocalBuffer::Write(const void* pData_src, VkDeviceSize size, VkDeviceSize offset)
+{
+    if (!MarkDirty(offset, size))
+        return false;
+    memcpy(shadowData.get() + offset, pData_src, size_t(size));
+    return true;
+}
+
+bool deviceLocalBuffer::MarkDirty(VkDeviceSize offset, VkDeviceSize size)
+{
+    if (!shadowData) {
+        qDebug("[ deviceLocalBuffer ] ERROR\nThe buffer has no shadow copy, call EnableShadow() first!\n");
+        return false;
+    }
+    //写成两个比较，以免offset + size溢出
+    if (offset > this->size || size > this->size - offset) {
+        qDebug("[ deviceLocalBuffer ] ERROR\nWrite out of range!\nOffset: %llu\nSize: %llu\nBuffer size: %llu\n",
+               (unsigned long long)offset, (unsigned long long)size, (unsigned long long)this->size);
+        return false;
+    }
+    if (!size)
+        return true;
+    VkDeviceSize begin = offset & ~VkDeviceSize(3);
+    VkDeviceSize end = std::min(offset + size + 3 & ~VkDeviceSize(3), this->size);
+    //区间互不相交，end也是有序的，找到第一个end不小于begin的区间，与之后所有begin不大于end的区间合并
+    auto first = std::lower_bound(dirtyRanges.begin(), dirtyRanges.end(), begin,
+                                  [](const dirtyRange& range, VkDeviceSize value) { return range.end < value; });
+    auto last = first;
+    for (; last != dirtyRanges.end() && last->begin <= end; ++last)
+        begin = std::min(begin, last->begin),
+        end = std::max(end, last->end);
+    if (first == last)
+        dirtyRanges.insert(first, { begin, end });
+    else
+        *first = { begin, end },
+        dirtyRanges.erase(first + 1, last);
+    return true;
+}
+
+uint32_t deviceLocalBuffer::Sync(VkCommandBuffer commandBuffer, uploadBatch& batch, VkDeviceSize mergeDistance)
+{
+    if (dirtyRanges.empty())
+        return 0;
+    //合并间隔不超过mergeDistance的区间，多上传几个未修改的字节比多一次拷贝便宜
+    size_t count = 0;
+    for (size_t i = 1; i < dirtyRanges.size(); i++)
+        if (dirtyRanges[i].begin - dirtyRanges[count].end <= mergeDistance)
+            dirtyRanges[count].end = dirtyRanges[i].end;
+        else
+            dirtyRanges[++count] = dirtyRanges[i];
+    dirtyRanges.resize(count + 1);
+
+    //小区间用vkCmdUpdateBuffer(...)内联在commandBuffer中，大区间经batch的stagingRing以vkCmdCopyBuffer(...)拷贝
+    uint32_t copyCount = 0;
+    bool barrierRecorded = false;
+    for (auto& i : dirtyRanges)
+        if (i.end - i.begin <= syncUpdateSizeLimit)
+            vkCmdUpdateBuffer(commandBuffer, buffer_memory.Buffer(), i.begin, i.end - i.begin, shadowData.get() + i.begin),
+            copyCount++;
+        else {
+            //之前提交的帧可能仍在读写缓冲区，第一次拷贝前等待之前的所有命令；分块提交时，之后的块在提交顺序上位于该屏障之后
+            if (!barrierRecorded) {
+                VkMemoryBarrier memoryBarrier = {
+                    VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                    nullptr,
+                    VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+                    VK_ACCESS_TRANSFER_WRITE_BIT
+                };
+                vkCmdPipelineBarrier(batch.CommandBuffer(), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                    1, &memoryBarrier, 0, nullptr, 0, nullptr);
+                barrierRecorded = true;
+            }
+            //失败时保留其余的脏区间，下一次Sync(...)时重试
+            if (!batch.CopyBuffer(buffer_memory.Buffer(), shadowData.get() + i.begin, i.end - i.begin, i.begin)) {
+                qDebug("[ deviceLocalBuffer ] ERROR\nFailed to stage a dirty range for Sync(...)!\n");
+                dirtyRanges.erase(dirtyRanges.begin(), dirtyRanges.begin() + (&i - dirtyRanges.data()));
+                return copyCount;
+            }
+            copyCount++;
+        }
+    dirtyRanges.clear();
+    return copyCount;
 }
 
 void deviceLocalBuffer::CmdUpdateBuffer(VkCommandBuffer commandBuffer, const void *pData_src, VkDeviceSize size_Limited_to_65536, VkDeviceSize offset) const
@@ -262,41 +725,116 @@ void deviceLocalBuffer::TransferData(const void *pData_src, VkDeviceSize size, V
         buffer_memory.BufferData(pData_src, size, offset);
         return;
     }
+    //数据量较大时经由当前线程的stagingRing分块上传，暂存区的占用不随数据量增长
+    if (size > stagingRing::ThisThread().Capacity() / uploadBatch::chunkCount) {
+        uploadBatch batch(stagingRing::ThisThread(), true);
+        batch.CopyBuffer(buffer_memory.Buffer(), pData_src, size, offset);
+        batch.Submit();
+        ExecuteOwnershipTransfer(offset, size);
+        return;
+    }
     //先将数据上传到暂存缓冲区 CPU内存(cpu可见,gpu不可见) -> CPU内存暂存区(cpu可见,gpu不可见)
     stagingBuffer::BufferData_MainThread(pData_src, size);
+    CopyFromStaging_MainThread(size, offset);
+}
+
+void deviceLocalBuffer::CopyFromStaging_MainThread(VkDeviceSize size, VkDeviceSize offset) const
+{
     //创建拷贝命令 CPU内存暂存区(cpu可见,gpu不可见)->GPU显存(cpu不可见,gpu可见)
-    auto& commandBuffer = graphicsBase::Plus().CommandBuffer_Transfer();
+    //若有专用的传输队列族，在传输队列上执行拷贝，不占用图形队列
+    auto& commandBuffer = graphicsBase::Plus().CommandBuffer_TransferQueue();
     commandBuffer.Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
     VkBufferCopy region = { 0, offset, size };
     vkCmdCopyBuffer(commandBuffer,stagingBuffer::Buffer_MainThread(),buffer_memory.Buffer(),1,&region);
+    VkBufferMemoryBarrier barrier = CmdReleaseOwnership_Transfer(commandBuffer, offset, size);
     commandBuffer.End();
     //执行拷贝命令
-    graphicsBase::Plus().ExecuteCommandBuffer_Graphics(commandBuffer);
+    graphicsBase::Plus().ExecuteCommandBuffer_Transfer(commandBuffer, barrier);
 }
 
 void deviceLocalBuffer::TransferData(const void *pData_src, uint32_t elementCount, VkDeviceSize elementSize, VkDeviceSize stride_src, VkDeviceSize stride_dst, VkDeviceSize offset) const
 {
+    if (!elementCount)
+        return;
+    //目标中被写入的范围：最后一个元素只占elementSize，而非stride_dst，以免offset + size越过缓冲区末尾
+    VkDeviceSize size_dst = stride_dst * (elementCount - 1) + elementSize;
     //具有VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT属性
     if(buffer_memory.MemoryProperties() & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT){
         void* pData_dst = nullptr;
-        buffer_memory.MapMemory(pData_dst,VkDeviceSize(stride_dst * elementCount),offset);
-        for(size_t i = 0; i < elementCount;i++){
-            memcpy(stride_dst * i + static_cast<uint8_t*>(pData_dst), stride_src * i + static_cast<const uint8_t*>(pData_src), size_t(elementSize));
-        }
-        buffer_memory.UnmapMemory(VkDeviceSize(stride_dst * elementCount),offset);
+        buffer_memory.MapMemory(pData_dst,size_dst,offset);
+        CopyStridedElements(pData_dst, size_t(stride_dst), pData_src, size_t(stride_src), size_t(elementSize), elementCount);
+        buffer_memory.UnmapMemory(size_dst,offset);
+        return;
+    }
+    if (elementCount * elementSize > stagingRing::ThisThread().Capacity() / uploadBatch::chunkCount) {
+        uploadBatch batch(stagingRing::ThisThread(), true);
+        batch.CopyBuffer(buffer_memory.Buffer(), pData_src, elementCount, elementSize, stride_src, stride_dst, offset);
+        batch.Submit();
+        ExecuteOwnershipTransfer(offset, size_dst);
         return;
     }
-    stagingBuffer::BufferData_MainThread(pData_src, elementCount * stride_src);
+    //只将元素本身紧密地写入暂存区
+    void* pData_staging = stagingBuffer::MapMemory_MainThread(elementCount * elementSize);
+    CopyStridedElements(pData_staging, size_t(elementSize), pData_src, size_t(stride_src), size_t(elementSize), elementCount);
+    stagingBuffer::UnmapMemory_MainThread();
 
-    auto& commandBuffer = graphicsBase::Plus().CommandBuffer_Transfer();
+    auto& commandBuffer = graphicsBase::Plus().CommandBuffer_TransferQueue();
     commandBuffer.Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-    std::vector<VkBufferCopy> regions(elementCount);
-    for (size_t i = 0; i < regions.size(); i++){
-        regions[i] = VkBufferCopy{ stride_src * i, stride_dst * i + offset, elementSize };
+    //目标也紧密排列时只需一个拷贝区域，否则每个元素一个区域（整段拷贝会覆盖元素之间的空隙）
+    if (stride_dst == elementSize) {
+        VkBufferCopy region = { 0, offset, elementCount * elementSize };
+        vkCmdCopyBuffer(commandBuffer, stagingBuffer::Buffer_MainThread(), buffer_memory.Buffer(), 1, &region);
+    }
+    else {
+        std::vector<VkBufferCopy> regions(elementCount);
+        for (size_t i = 0; i < regions.size(); i++){
+            regions[i] = VkBufferCopy{ elementSize * i, stride_dst * i + offset, elementSize };
+        }
+        vkCmdCopyBuffer(commandBuffer, stagingBuffer::Buffer_MainThread(), buffer_memory.Buffer(), elementCount, regions.data());
     }
-    vkCmdCopyBuffer(commandBuffer, stagingBuffer::Buffer_MainThread(), buffer_memory.Buffer(), elementCount, regions.data());
+    VkBufferMemoryBarrier barrier = CmdReleaseOwnership_Transfer(commandBuffer, offset, size_dst);
     commandBuffer.End();
-    graphicsBase::Plus().ExecuteCommandBuffer_Graphics(commandBuffer);
+    graphicsBase::Plus().ExecuteCommandBuffer_Transfer(commandBuffer, barrier);
+}
+
+VkBufferMemoryBarrier deviceLocalBuffer::CmdReleaseOwnership_Transfer(VkCommandBuffer commandBuffer, VkDeviceSize offset, VkDeviceSize size) const
+{
+    VkBufferMemoryBarrier barrier = {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        nullptr,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        0,
+        graphicsBase::Base().QueueFamilyIndex_Transfer(),
+        graphicsBase::Base().QueueFamilyIndex_Graphics(),
+        buffer_memory.Buffer(),
+        offset,
+        size
+    };
+    //没有专用的传输队列族时无需转移所有权，之后的访问由ExecuteCommandBuffer_Graphics(...)中的栅栏保证在拷贝完成后
+    if (graphicsBase::Base().HasDedicatedTransferQueue())
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+            0, nullptr, 1, &barrier, 0, nullptr);
+    return barrier;
+}
+
+void deviceLocalBuffer::ExecuteOwnershipTransfer(VkDeviceSize offset, VkDeviceSize size) const
+{
+    //分块拷贝都已提交到传输队列，这里录制的屏障在提交顺序上位于所有拷贝之后
+    auto& commandBuffer = graphicsBase::Plus().CommandBuffer_TransferQueue();
+    commandBuffer.Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    VkBufferMemoryBarrier barrier = CmdReleaseOwnership_Transfer(commandBuffer, offset, size);
+    commandBuffer.End();
+    graphicsBase::Plus().ExecuteCommandBuffer_Transfer(commandBuffer, barrier);
+}
+
+void deviceLocalBuffer::TransferData(uploadBatch& batch, const void* pData_src, VkDeviceSize size, VkDeviceSize offset) const
+{
+    //具有VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT属性，直接写入，无需拷贝命令
+    if (buffer_memory.MemoryProperties() & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        buffer_memory.BufferData(pData_src, size, offset);
+        return;
+    }
+    batch.CopyBuffer(buffer_memory.Buffer(), pData_src, size, offset);
 }
 
 vertexBuffer::vertexBuffer(VkDeviceSize size, VkBufferUsageFlags otherUsages):
@@ -315,6 +853,29 @@ void vertexBuffer::Recreate(VkDeviceSize size, VkBufferUsageFlags otherUsages)
     deviceLocalBuffer::Recreate(size,VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | otherUsages);
 }
 
+void vertexBuffer::TransferQuantized(const vertexQuantizer& quantizer, const void* pData_src, VkDeviceSize stride_src, uint32_t vertexCount, VkDeviceSize offset) const
+{
+    VkDeviceSize dataSize = VkDeviceSize(quantizer.Stride()) * vertexCount;
+    if (!dataSize)
+        return;
+    if (offset + dataSize > size) {
+        qDebug("[ vertexBuffer ] ERROR\nQuantized vertices exceed the buffer!\nRequired size: %llu\nBuffer size: %llu\n", (unsigned long long)(offset + dataSize), (unsigned long long)size);
+        return;
+    }
+    //具有VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT属性，直接量化到映射的内存
+    if (buffer_memory.MemoryProperties() & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        void* pData_dst = nullptr;
+        if (buffer_memory.MapMemory(pData_dst, dataSize, offset))
+            return;
+        quantizer.Quantize(pData_dst, pData_src, size_t(stride_src), vertexCount);
+        buffer_memory.UnmapMemory(dataSize, offset);
+        return;
+    }
+    //否则量化到临时数组，由TransferData(...)上传，大量顶点会经由stagingRing分块上传，不扩大主线程的暂存缓冲区
+    std::vector<uint8_t> data_quantized = quantizer.Quantize(pData_src, size_t(stride_src), vertexCount);
+    TransferData(data_quantized.data(), dataSize, offset);
+}
+
 indexBuffer::indexBuffer(VkDeviceSize size, VkBufferUsageFlags otherUsages):
     deviceLocalBuffer(size,VK_BUFFER_USAGE_INDEX_BUFFER_BIT | otherUsages)
 {
@@ -331,20 +892,42 @@ void indexBuffer::Recreate(VkDeviceSize size, VkBufferUsageFlags otherUsages)
     deviceLocalBuffer::Recreate(size,VK_BUFFER_USAGE_INDEX_BUFFER_BIT | otherUsages);
 }
 
+VkIndexType indexBuffer::TransferIndices(const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount, VkBufferUsageFlags otherUsages)
+{
+    //0xffff在开启primitive restart时表示重启图元，不作为16位索引使用
+    VkIndexType indexType = vertexCount < 0xffff ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    VkDeviceSize dataSize = VkDeviceSize(indexCount) * (indexType == VK_INDEX_TYPE_UINT16 ? 2 : 4);
+    if (!dataSize)
+        return this->indexCount = 0, this->indexType = indexType;
+    if (!*this)
+        Create(dataSize, otherUsages);
+    else if (Size() < dataSize)
+        Recreate(dataSize, otherUsages);
+    if (indexType == VK_INDEX_TYPE_UINT16) {
+        //转换后与32位索引走同一个TransferData(...)，host visible时直接写入，数据量大时分块上传
+        std::vector<uint16_t> indices_16Bit(pIndices, pIndices + indexCount);
+        TransferData(indices_16Bit.data(), dataSize);
+    }
+    else
+        TransferData(pIndices, dataSize);
+    this->indexCount = indexCount;
+    return this->indexType = indexType;
+}
+
 uniformBuffer::uniformBuffer(VkDeviceSize size, VkBufferUsageFlags otherUsages):
-    deviceLocalBuffer(size,VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT | otherUsages)
+    deviceLocalBuffer(size,VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | otherUsages)
 {
 
 }
 
 void uniformBuffer::Create(VkDeviceSize size, VkBufferUsageFlags otherUsages)
 {
-    deviceLocalBuffer::Create(size,VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT | otherUsages);
+    deviceLocalBuffer::Create(size,VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | otherUsages);
 }
 
 void uniformBuffer::Recreate(VkDeviceSize size, VkBufferUsageFlags otherUsages)
 {
-    deviceLocalBuffer::Recreate(size,VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT | otherUsages);
+    deviceLocalBuffer::Recreate(size,VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | otherUsages);
 }
 
 VkDeviceSize uniformBuffer::CalculateAlignedSize(VkDeviceSize dataSize)
@@ -353,20 +936,85 @@ VkDeviceSize uniformBuffer::CalculateAlignedSize(VkDeviceSize dataSize)
     return dataSize + alignment - 1 & ~(alignment - 1); //等价于(dataSize + alignment - 1) / alignment * alignment
 }
 
+uniformRingBuffer::uniformRingBuffer(VkDeviceSize sizePerFrame, uint32_t frameCount)
+{
+    Create(sizePerFrame, frameCount);
+}
+
+void uniformRingBuffer::FlushFrame() const
+{
+    VkDeviceSize frameBegin = sizePerFrame * currentFrame;
+    if (head > frameBegin)
+        buffer_memory.FlushMappedMemoryRange(head - frameBegin, frameBegin);
+}
+
+void uniformRingBuffer::FlushFrame(mappedMemoryRangeBatch& batch) const
+{
+    VkDeviceSize frameBegin = sizePerFrame * currentFrame;
+    if (head > frameBegin)
+        batch.Add(buffer_memory, head - frameBegin, frameBegin);
+}
+
+void uniformRingBuffer::Create(VkDeviceSize sizePerFrame, uint32_t frameCount)
+{
+    //每段的起始位置都要满足minUniformBufferOffsetAlignment
+    this->sizePerFrame = uniformBuffer::CalculateAlignedSize(sizePerFrame);
+    this->frameCount = frameCount;
+    currentFrame = 0;
+    head = 0;
+    VkBufferCreateInfo bufferCreateInfo = {};
+    bufferCreateInfo.size = this->sizePerFrame * frameCount;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    //memoryTypeSelector::dynamic优先选择device local且host visible的内存，没有则退而选择host visible的内存
+    false ||
+    buffer_memory.CreateBuffer(bufferCreateInfo) ||
+    buffer_memory.AllocateMemory(memoryTypeSelector::dynamic) ||
+    buffer_memory.BindMemory() ||
+    buffer_memory.MapPersistently();
+}
+
+void uniformRingBuffer::NextFrame()
+{
+    currentFrame = (currentFrame + 1) % frameCount;
+    head = sizePerFrame * currentFrame;
+}
+
+void* uniformRingBuffer::Allocate(VkDeviceSize size, uint32_t& dynamicOffset)
+{
+    VkDeviceSize alignedSize = uniformBuffer::CalculateAlignedSize(size);
+    if (head + alignedSize > sizePerFrame * (currentFrame + 1)) {
+        qDebug("[ uniformRingBuffer ] ERROR\nOut of space in the current frame!\nRequested: %llu bytes\n", (unsigned long long)size);
+        return nullptr;
+    }
+    dynamicOffset = uint32_t(head);
+    head += alignedSize;
+    return static_cast<uint8_t*>(buffer_memory.MappedData()) + dynamicOffset;
+}
+
+uint32_t uniformRingBuffer::Push(const void* pData_src, VkDeviceSize size)
+{
+    uint32_t dynamicOffset;
+    void* pData_dst = Allocate(size, dynamicOffset);
+    if (!pData_dst)
+        return UINT32_MAX;
+    memcpy(pData_dst, pData_src, size_t(size));
+    return dynamicOffset;
+}
+
 storageBuffer::storageBuffer(VkDeviceSize size, VkBufferUsageFlags otherUsages):
-    deviceLocalBuffer(size,VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT | otherUsages)
+    deviceLocalBuffer(size,VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT | otherUsages)
 {
 
 }
 
 void storageBuffer::Create(VkDeviceSize size, VkBufferUsageFlags otherUsages)
 {
-    deviceLocalBuffer::Create(size,VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT | otherUsages);
+    deviceLocalBuffer::Create(size,VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT | otherUsages);
 }
 
 void storageBuffer::Recreate(VkDeviceSize size, VkBufferUsageFlags otherUsages)
 {
-    deviceLocalBuffer::Recreate(size,VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT | otherUsages);
+    deviceLocalBuffer::Recreate(size,VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT | otherUsages);
 }
 
 VkDeviceSize storageBuffer::CalculateAlignedSize(VkDeviceSize dataSize)
@@ -374,3 +1022,1201 @@ VkDeviceSize storageBuffer::CalculateAlignedSize(VkDeviceSize dataSize)
     const auto& alignment = graphicsBase::Base().PhysicalDeviceProperties().limits.minStorageBufferOffsetAlignment;
     return dataSize + alignment - 1 & ~(alignment - 1); //等价于(dataSize + alignment - 1) / alignment * alignment
 }
+
+gpuVectorBase::gpuVectorBase(VkDeviceSize elementSize, VkBufferUsageFlags desiredUsages_Without_transfer, size_t capacity)
+{
+    Create(elementSize, desiredUsages_Without_transfer, capacity);
+}
+
+result_t gpuVectorBase::Create(VkDeviceSize elementSize, VkBufferUsageFlags desiredUsages_Without_transfer, size_t capacity)
+{
+    //扩张和Erase(...)时缓冲区既是拷贝的源也是拷贝的目标
+    this->usages = desiredUsages_Without_transfer | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    this->elementSize = elementSize;
+    count = 0;
+    this->capacity = 0;
+    if (capacity)
+        return Reallocate(capacity);
+    return VK_SUCCESS;
+}
+
+result_t gpuVectorBase::Reallocate(size_t newCapacity)
+{
+    bufferMemory buffer_memory_old(std::move(buffer_memory));
+    VkDeviceSize size_old = size;
+    if (VkResult result = deviceLocalBuffer::Create(elementSize * newCapacity, usages)) {
+        qDebug("[ gpuVector ] ERROR\nFailed to reallocate the buffer!\nCapacity: %llu\nError code: %d\n", (unsigned long long)newCapacity, int32_t(result));
+        //保留旧缓冲区，其中的元素不受影响
+        buffer_memory.~bufferMemory();
+        new (&buffer_memory) bufferMemory(std::move(buffer_memory_old));
+        size = size_old;
+        return result;
+    }
+    capacity = newCapacity;
+    if (count) {
+        auto& commandBuffer = graphicsBase::Plus().CommandBuffer_Transfer();
+        commandBuffer.Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        //之前提交的命令可能以任何方式写入了旧缓冲区
+        VkMemoryBarrier memoryBarrier = {
+            VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            nullptr,
+            VK_ACCESS_MEMORY_WRITE_BIT,
+            VK_ACCESS_TRANSFER_READ_BIT
+        };
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            1, &memoryBarrier, 0, nullptr, 0, nullptr);
+        VkBufferCopy region = { 0, 0, SizeInBytes() };
+        vkCmdCopyBuffer(commandBuffer, buffer_memory_old.Buffer(), buffer_memory.Buffer(), 1, &region);
+        //之后提交的命令对新缓冲区的访问在拷贝之后
+        memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+            1, &memoryBarrier, 0, nullptr, 0, nullptr);
+        commandBuffer.End();
+        graphicsBase::Plus().ExecuteCommandBuffer_Graphics(commandBuffer);
+    }
+    //旧缓冲区可能仍被之前提交的帧使用，不能立刻销毁
+    deferredDestructionQueue::Get().Push(buffer_memory_old);
+    return VK_SUCCESS;
+}
+
+result_t gpuVectorBase::Reserve(size_t capacity)
+{
+    if (capacity > this->capacity)
+        return Reallocate(std::max(capacity, this->capacity * 2));
+    return VK_SUCCESS;
+}
+
+void gpuVectorBase::Append(const void* pData_src, size_t appendCount)
+{
+    if (!appendCount)
+        return;
+    //扩张失败时不追加，已有的元素不变
+    if (Reserve(count + appendCount))
+        return;
+    TransferData(pData_src, elementSize * appendCount, elementSize * count);
+    count += appendCount;
+}
+
+void gpuVectorBase::Update(size_t index, const void* pData_src, size_t updateCount) const
+{
+    if (index + updateCount > count) {
+        qDebug("[ gpuVector ] ERROR\nUpdate out of range!\nIndex: %llu\nCount: %llu\nSize: %llu\n",
+               (unsigned long long)index, (unsigned long long)updateCount, (unsigned long long)count);
+        return;
+    }
+    TransferData(pData_src, elementSize * updateCount, elementSize * index);
+}
+
+void gpuVectorBase::Erase(size_t index, size_t eraseCount)
+{
+    if (index + eraseCount > count) {
+        qDebug("[ gpuVector ] ERROR\nErase out of range!\nIndex: %llu\nCount: %llu\nSize: %llu\n",
+               (unsigned long long)index, (unsigned long long)eraseCount, (unsigned long long)count);
+        return;
+    }
+    size_t tailCount = count - index - eraseCount;
+    size_t end = count;
+    count -= eraseCount;
+    if (!eraseCount || !tailCount)
+        return;
+    //尾部比被删除的部分长且空闲的容量不足以容纳尾部时，经临时缓冲区中转，尾部只需拷出、拷回各一次
+    bufferMemory scratch;
+    bool useScratch = false;
+    if (tailCount > eraseCount && capacity - end < tailCount) {
+        VkBufferCreateInfo bufferCreateInfo = {};
+        bufferCreateInfo.size = elementSize * tailCount;
+        bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        //创建失败时退回分段前移
+        useScratch = !scratch.Create(bufferCreateInfo, memoryTypeSelector::gpuOnly);
+    }
+    auto& commandBuffer = graphicsBase::Plus().CommandBuffer_Transfer();
+    commandBuffer.Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    VkMemoryBarrier memoryBarrier = {
+        VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        nullptr,
+        VK_ACCESS_MEMORY_WRITE_BIT,
+        VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+        1, &memoryBarrier, 0, nullptr, 0, nullptr);
+    //从buffer_src的[src, src + n)拷贝到buffer_dst的[dst, dst + n)，以元素计，拷贝之间插入屏障
+    auto CmdCopy = [&](VkBuffer buffer_src, size_t src, VkBuffer buffer_dst, size_t dst, size_t n, bool barrier) {
+        VkBufferCopy region = { elementSize * src, elementSize * dst, elementSize * n };
+        vkCmdCopyBuffer(commandBuffer, buffer_src, buffer_dst, 1, &region);
+        if (barrier) {
+            VkMemoryBarrier memoryBarrier_transfer = {
+                VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                nullptr,
+                VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT
+            };
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                1, &memoryBarrier_transfer, 0, nullptr, 0, nullptr);
+        }
+    };
+    //vkCmdCopyBuffer(...)的源与目标不能重叠
+    //1.尾部不长于被删除的部分时，一次拷贝即可
+    VkBuffer buffer = buffer_memory.Buffer();
+    if (tailCount <= eraseCount)
+        CmdCopy(buffer, index + eraseCount, buffer, index, tailCount, false);
+    //2.空闲的容量足以容纳尾部时，先将尾部拷贝到末尾之后，再拷贝回来
+    else if (capacity - end >= tailCount)
+        CmdCopy(buffer, index + eraseCount, buffer, end, tailCount, true),
+        CmdCopy(buffer, end, buffer, index, tailCount, false);
+    //3.否则先将尾部拷贝到临时缓冲区，再拷贝回来
+    else if (useScratch)
+        CmdCopy(buffer, index + eraseCount, scratch.Buffer(), 0, tailCount, true),
+        CmdCopy(scratch.Buffer(), 0, buffer, index, tailCount, false);
+    //4.临时缓冲区创建失败时，以eraseCount为步长分段前移
+    else
+        for (size_t i = 0; i < tailCount; i += eraseCount)
+            CmdCopy(buffer, index + eraseCount + i, buffer, index + i, std::min(eraseCount, tailCount - i), i + eraseCount < tailCount);
+    memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+        1, &memoryBarrier, 0, nullptr, 0, nullptr);
+    commandBuffer.End();
+    //等待执行完毕，临时缓冲区在函数返回时即可销毁
+    graphicsBase::Plus().ExecuteCommandBuffer_Graphics(commandBuffer);
+}
+
+uploadBatch::uploadBatch(stagingRing& ring, bool transferQueue) :
+    staging_ring(ring),
+    onTransferQueue(transferQueue),
+    command_pool(transferQueue ? graphicsBase::Base().QueueFamilyIndex_Transfer() : graphicsBase::Base().QueueFamilyIndex_Graphics(),
+                 VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT)
+{
+
+}
+
+uploadBatch::~uploadBatch()
+{
+    //命令池销毁时会释放其中的命令缓冲区，须等待已提交的命令执行完毕
+    if (submissions.size())
+        staging_ring.Wait(submissions.back().position);
+}
+
+VkCommandBuffer uploadBatch::CommandBuffer()
+{
+    if (currentCommandBuffer)
+        return currentCommandBuffer;
+    RecycleCommandBuffers();
+    if (freeCommandBuffers.size())
+        currentCommandBuffer = freeCommandBuffers.back(),
+        freeCommandBuffers.pop_back();
+    else
+        command_pool.AllocateBuffers(currentCommandBuffer);
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (VkResult result = vkBeginCommandBuffer(currentCommandBuffer, &beginInfo))
+        qDebug("[ uploadBatch ] ERROR\nFailed to begin a command buffer!\nError code: %d\n", int32_t(result));
+    return currentCommandBuffer;
+}
+
+void uploadBatch::RecycleCommandBuffers()
+{
+    while (submissions.size() &&
+           staging_ring.IsComplete(submissions.front().position))
+        freeCommandBuffers.push_back(submissions.front().commandBuffer),
+        submissions.pop_front();
+}
+
+void* uploadBatch::AllocateStaging(VkDeviceSize size, VkDeviceSize& offset, VkDeviceSize alignment)
+{
+    void* pData_dst = staging_ring.Allocate(size, offset, alignment);
+    //当前批次占满了stagingRing，先提交已录制的部分再重试
+    if (!pData_dst && !Empty())
+        Submit(),
+        pData_dst = staging_ring.Allocate(size, offset, alignment);
+    return pData_dst;
+}
+
+bool uploadBatch::CopyBuffer(VkBuffer buffer_dst, const void* pData_src, VkDeviceSize size, VkDeviceSize offset_dst)
+{
+    VkDeviceSize chunkSize = ChunkSize();
+    if (size > chunkSize) {
+        for (VkDeviceSize i = 0; i < size; i += chunkSize) {
+            if (!CopyBuffer(buffer_dst, static_cast<const uint8_t*>(pData_src) + i, std::min(chunkSize, size - i), offset_dst + i))
+                return false;
+            //每块单独提交，GPU拷贝这一块的同时CPU写入下一块
+            Submit();
+        }
+        return true;
+    }
+    VkDeviceSize offset_src;
+    void* pData_dst = AllocateStaging(size, offset_src);
+    if (!pData_dst)
+        return false;
+    memcpy(pData_dst, pData_src, size_t(size));
+    VkBufferCopy region = { offset_src, offset_dst, size };
+    vkCmdCopyBuffer(CommandBuffer(), staging_ring, buffer_dst, 1, &region);
+    return true;
+}
+
+bool uploadBatch::CopyBuffer(VkBuffer buffer_dst, const void* pData_src,
+                             uint32_t elementCount, VkDeviceSize elementSize, VkDeviceSize stride_src, VkDeviceSize stride_dst, VkDeviceSize offset_dst)
+{
+    bool chunked = elementCount * elementSize > ChunkSize();
+    uint32_t elementCountPerChunk = uint32_t(std::max(ChunkSize() / elementSize, VkDeviceSize(1)));
+    std::vector<VkBufferCopy> regions;
+    for (uint32_t i = 0; i < elementCount; i += elementCountPerChunk) {
+        uint32_t count = std::min(elementCountPerChunk, elementCount - i);
+        VkDeviceSize offset_src;
+        uint8_t* pData_dst = static_cast<uint8_t*>(AllocateStaging(count * elementSize, offset_src));
+        if (!pData_dst)
+            return false;
+        CopyStridedElements(pData_dst, size_t(elementSize), static_cast<const uint8_t*>(pData_src) + stride_src * i, size_t(stride_src), size_t(elementSize), count);
+        //目标紧密排列时只需一个拷贝区域
+        if (stride_dst == elementSize)
+            regions.assign(1, { offset_src, offset_dst + elementSize * i, elementSize * count });
+        else {
+            regions.resize(count);
+            for (uint32_t j = 0; j < count; j++)
+                regions[j] = { offset_src + elementSize * j, offset_dst + stride_dst * (i + j), elementSize };
+        }
+        vkCmdCopyBuffer(CommandBuffer(), staging_ring, buffer_dst, uint32_t(regions.size()), regions.data());
+        if (chunked)
+            Submit();
+    }
+    return true;
+}
+
+bool uploadBatch::CopyBufferToImage(VkImage image_dst, VkFormat format, const void* pData_src, VkDeviceSize size, VkBufferImageCopy region,
+                                    imageOperation::imageMemoryBarrierParameterPack imb_from,
+                                    imageOperation::imageMemoryBarrierParameterPack imb_to)
+{
+    const uint8_t* pData = static_cast<const uint8_t*>(pData_src);
+    uint32_t& width = region.imageExtent.width;
+    uint32_t& height = region.imageExtent.height;
+    uint32_t& depth = region.imageExtent.depth;
+    uint32_t layerCount = region.imageSubresource.layerCount;
+    //分块按行（texel）划分，压缩格式以块为单位，行数须为块高的倍数，不支持
+    VkDeviceSize texelSize = FormatInfo(format).sizePerPixel;
+    if (!texelSize) {
+        qDebug("[ uploadBatch ] ERROR\nBlock-compressed or unknown formats are not supported!\nFormat: %d\n", int32_t(format));
+        return false;
+    }
+    if (size != texelSize * width * height * depth * layerCount) {
+        qDebug("[ uploadBatch ] ERROR\nData size does not match the image region!\nData size: %llu\nRequired size: %llu\n",
+               (unsigned long long)size, (unsigned long long)(texelSize * width * height * depth * layerCount));
+        return false;
+    }
+    VkDeviceSize chunkSize = ChunkSize();
+    region.bufferRowLength = region.bufferImageHeight = 0;
+    //各图层是不同的子资源，须各自转换内存布局，因此每个图层都使用imb_from和imb_to
+    if (size > chunkSize && layerCount > 1) {
+        VkDeviceSize layerSize = size / layerCount;
+        region.imageSubresource.layerCount = 1;
+        for (uint32_t i = 0; i < layerCount; i++, region.imageSubresource.baseArrayLayer++)
+            if (!CopyBufferToImage(image_dst, format, pData + layerSize * i, layerSize, region, imb_from, imb_to))
+                return false;
+        return true;
+    }
+    VkDeviceSize rowSize = texelSize * width;
+    //bufferOffset须为4和texel大小的倍数
+    VkDeviceSize alignment = texelSize % 4 ? texelSize * 4 : texelSize;
+    if (size <= chunkSize) {
+        void* pData_dst = AllocateStaging(size, region.bufferOffset, alignment);
+        if (!pData_dst)
+            return false;
+        memcpy(pData_dst, pData_src, size_t(size));
+        imageOperation::CmdCopyBufferToImage(CommandBuffer(), staging_ring, image_dst, region, imb_from, imb_to);
+        return true;
+    }
+    //一个深度切片能放进一块时，每块包含若干完整的切片，否则每块包含一个切片中的若干行
+    VkDeviceSize sliceSize = rowSize * height;
+    uint32_t rowCountPerChunk = sliceSize <= chunkSize ? height : uint32_t(std::max(chunkSize / rowSize, VkDeviceSize(1)));
+    uint32_t sliceCountPerChunk = sliceSize <= chunkSize ? uint32_t(chunkSize / sliceSize) : 1;
+    for (uint32_t z = 0; z < depth; z += sliceCountPerChunk)
+        for (uint32_t y = 0; y < height; y += rowCountPerChunk) {
+            VkBufferImageCopy region_chunk = region;
+            region_chunk.imageOffset.y += y;
+            region_chunk.imageOffset.z += z;
+            region_chunk.imageExtent.height = std::min(rowCountPerChunk, height - y);
+            region_chunk.imageExtent.depth = std::min(sliceCountPerChunk, depth - z);
+            VkDeviceSize size_chunk = rowSize * region_chunk.imageExtent.height * region_chunk.imageExtent.depth;
+            void* pData_dst = AllocateStaging(size_chunk, region_chunk.bufferOffset, alignment);
+            if (!pData_dst)
+                return false;
+            memcpy(pData_dst, pData, size_t(size_chunk));
+            pData += size_chunk;
+            //之后的块在提交顺序上位于第一块的布局转换之后，最后一块的屏障覆盖之前所有块的写入
+            bool first = !y && !z;
+            bool last = y + region_chunk.imageExtent.height == height && z + region_chunk.imageExtent.depth == depth;
+            imageOperation::CmdCopyBufferToImage(CommandBuffer(), staging_ring, image_dst, region_chunk,
+                first ? imb_from : imageOperation::imageMemoryBarrierParameterPack(),
+                last ? imb_to : imageOperation::imageMemoryBarrierParameterPack());
+            Submit();
+        }
+    return true;
+}
+
+uploadBatch::ticket uploadBatch::Submit()
+{
+    if (!currentCommandBuffer)
+        return ticket();
+    //使拷贝的写入对之后提交到同一队列的任何访问可见，使用者无需等待ticket即可使用数据
+    //专用传输队列族上的写入须由使用者转移所有权，获取所有权的屏障即起到同样的作用
+    if (!onTransferQueue || !graphicsBase::Base().HasDedicatedTransferQueue()) {
+        VkMemoryBarrier memoryBarrier = {
+            VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            nullptr,
+            VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT
+        };
+        vkCmdPipelineBarrier(currentCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+            1, &memoryBarrier, 0, nullptr, 0, nullptr);
+    }
+    if (VkResult result = vkEndCommandBuffer(currentCommandBuffer))
+        qDebug("[ uploadBatch ] ERROR\nFailed to end a command buffer!\nError code: %d\n", int32_t(result));
+    VkFence fence = staging_ring.EndBatch();
+    VkDeviceSize position = staging_ring.Head();
+    if (onTransferQueue)
+        graphicsBase::Base().SubmitCommandBuffer_Transfer(currentCommandBuffer, (VkSemaphore)VK_NULL_HANDLE, fence);
+    else
+        graphicsBase::Base().SubmitCommandBuffer_Graphics(currentCommandBuffer, fence);
+    submissions.push_back({ position, currentCommandBuffer });
+    currentCommandBuffer = (VkCommandBuffer)VK_NULL_HANDLE;
+    return ticket(staging_ring, position);
+}
+
+readbackRing::readbackRing(VkDeviceSize sizePerSlot, uint32_t slotCount)
+{
+    Create(sizePerSlot, slotCount);
+}
+
+readbackRing::~readbackRing()
+{
+    //命令池销毁时会释放其中的命令缓冲区，须等待在途的拷贝完成，不再交付结果
+    for (auto& i : slots)
+        if (i->isPending)
+            i->fence_copied.Wait();
+}
+
+void readbackRing::Create(VkDeviceSize sizePerSlot, uint32_t slotCount)
+{
+    WaitAll();
+    for (auto& i : slots)
+        command_pool.FreeBuffers(i->commandBuffer);
+    slots.clear();
+    if (!command_pool)
+        command_pool.Create(graphicsBase::Base().QueueFamilyIndex_Graphics(), VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+    VkBufferCreateInfo bufferCreateInfo = {};
+    bufferCreateInfo.size = sizePerSlot;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    for (uint32_t i = 0; i < slotCount; i++) {
+        slots.push_back(std::make_unique<slot>());
+        slot& slot_new = *slots.back();
+        false ||
+        slot_new.buffer_memory.Create(bufferCreateInfo, memoryTypeSelector::readback) ||
+        slot_new.buffer_memory.MapPersistently() ||
+        command_pool.AllocateBuffers(slot_new.commandBuffer);
+    }
+    this->sizePerSlot = sizePerSlot;
+    next = oldest = 0;
+}
+
+readbackRing::slot* readbackRing::BeginSlot(VkDeviceSize size)
+{
+    if (size > sizePerSlot) {
+        qDebug("[ readbackRing ] ERROR\nRequested size exceeds the size of a slot!\nRequested: %llu bytes\n", (unsigned long long)size);
+        return nullptr;
+    }
+    Poll();
+    slot& slot_next = *slots[next];
+    if (slot_next.isPending)
+        return nullptr;
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (VkResult result = vkBeginCommandBuffer(slot_next.commandBuffer, &beginInfo)) {
+        qDebug("[ readbackRing ] ERROR\nFailed to begin a command buffer!\nError code: %d\n", int32_t(result));
+        return nullptr;
+    }
+    return &slot_next;
+}
+
+void readbackRing::SubmitSlot(slot& slot_current, VkDeviceSize size, callback_t&& callback)
+{
+    //使拷贝写入的数据对CPU可见
+    VkBufferMemoryBarrier bufferMemoryBarrier = {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        nullptr,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_ACCESS_HOST_READ_BIT,
+        VK_QUEUE_FAMILY_IGNORED,
+        VK_QUEUE_FAMILY_IGNORED,
+        slot_current.buffer_memory.Buffer(),
+        0,
+        size
+    };
+    vkCmdPipelineBarrier(slot_current.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+        0, nullptr, 1, &bufferMemoryBarrier, 0, nullptr);
+    if (VkResult result = vkEndCommandBuffer(slot_current.commandBuffer))
+        qDebug("[ readbackRing ] ERROR\nFailed to end a command buffer!\nError code: %d\n", int32_t(result));
+    slot_current.size = size;
+    slot_current.callback = std::move(callback);
+    slot_current.isPending = true;
+    graphicsBase::Base().SubmitCommandBuffer_Graphics(slot_current.commandBuffer, slot_current.fence_copied);
+    next = (next + 1) % slots.size();
+}
+
+bool readbackRing::Deliver(bool wait)
+{
+    slot& slot_oldest = *slots[oldest];
+    if (!slot_oldest.isPending)
+        return false;
+    if (slot_oldest.fence_copied.Status() != VK_SUCCESS) {
+        if (!wait)
+            return false;
+        slot_oldest.fence_copied.Wait();
+    }
+    slot_oldest.fence_copied.Reset();
+    slot_oldest.buffer_memory.InvalidateMappedMemoryRange(slot_oldest.size);
+    oldest = (oldest + 1) % slots.size();
+    //交付完毕后才回收该槽，防止callback中发起的回读覆盖正在读取的数据
+    callback_t callback = std::move(slot_oldest.callback);
+    if (callback)
+        callback(slot_oldest.buffer_memory.MappedData(), slot_oldest.size);
+    slot_oldest.isPending = false;
+    return true;
+}
+
+bool readbackRing::CopyImage(VkImage image, VkDeviceSize size, VkBufferImageCopy region,
+                             imageOperation::imageMemoryBarrierParameterPack imb_from,
+                             imageOperation::imageMemoryBarrierParameterPack imb_to,
+                             callback_t callback)
+{
+    slot* pSlot = BeginSlot(size);
+    if (!pSlot)
+        return false;
+    region.bufferOffset = region.bufferRowLength = region.bufferImageHeight = 0;
+    imageOperation::CmdCopyImageToBuffer(pSlot->commandBuffer, image, pSlot->buffer_memory.Buffer(), region, imb_from, imb_to);
+    SubmitSlot(*pSlot, size, std::move(callback));
+    return true;
+}
+
+bool readbackRing::CopyBuffer(VkBuffer buffer, VkDeviceSize size, VkDeviceSize offset, callback_t callback)
+{
+    slot* pSlot = BeginSlot(size);
+    if (!pSlot)
+        return false;
+    //之前提交的命令可能以任何方式写入了该缓冲区
+    VkMemoryBarrier memoryBarrier = {
+        VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        nullptr,
+        VK_ACCESS_MEMORY_WRITE_BIT,
+        VK_ACCESS_TRANSFER_READ_BIT
+    };
+    vkCmdPipelineBarrier(pSlot->commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+        1, &memoryBarrier, 0, nullptr, 0, nullptr);
+    VkBufferCopy region = { offset, 0, size };
+    vkCmdCopyBuffer(pSlot->commandBuffer, buffer, pSlot->buffer_memory.Buffer(), 1, &region);
+    SubmitSlot(*pSlot, size, std::move(callback));
+    return true;
+}
+
+uint32_t readbackRing::Poll()
+{
+    uint32_t count = 0;
+    while (slots.size() && Deliver(false))
+        count++;
+    return count;
+}
+
+void readbackRing::WaitAll()
+{
+    while (slots.size() && Deliver(true));
+}
+
+bufferScatter::bufferScatter(VkDeviceSize sizePerFrame, uint32_t frameCount, uint32_t maxDestinationCount)
+{
+    Create(sizePerFrame, frameCount, maxDestinationCount);
+}
+
+void bufferScatter::Create(VkDeviceSize sizePerFrame, uint32_t frameCount, uint32_t maxDestinationCount)
+{
+    //着色器以4字节为单位读取记录，每帧的段以动态偏移绑定，须满足minStorageBufferOffsetAlignment
+    const VkPhysicalDeviceLimits& limits = graphicsBase::Base().PhysicalDeviceProperties().limits;
+    VkDeviceSize alignment = std::max(limits.minStorageBufferOffsetAlignment, VkDeviceSize(4));
+    //动态偏移为uint32_t，最后一段的起始位置亦不能超过其上限
+    VkDeviceSize maxSizePerFrame = std::min(VkDeviceSize(limits.maxStorageBufferRange), VkDeviceSize(UINT32_MAX) / std::max(frameCount - 1, 1u)) & ~(alignment - 1);
+    if (sizePerFrame > maxSizePerFrame)
+        qDebug("[ bufferScatter ] WARNING\nSize per frame exceeds the descriptor range limit, clamped!\nRequested: %llu bytes\nClamped: %llu bytes\n",
+               (unsigned long long)sizePerFrame, (unsigned long long)maxSizePerFrame),
+        sizePerFrame = maxSizePerFrame;
+    this->sizePerFrame = sizePerFrame + alignment - 1 & ~(alignment - 1);
+    this->frameCount = frameCount;
+    this->maxDestinationCount = maxDestinationCount;
+    currentFrame = 0;
+    head = 0;
+    Clear();
+    descriptorSets.clear();
+    VkBufferCreateInfo bufferCreateInfo = {};
+    bufferCreateInfo.size = this->sizePerFrame * frameCount;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    //memoryTypeSelector::dynamic优先选择device local且host visible的内存，记录只被读取一次，直接从该内存读取
+    false ||
+    buffer_memory.CreateBuffer(bufferCreateInfo) ||
+    buffer_memory.AllocateMemory(memoryTypeSelector::dynamic) ||
+    buffer_memory.BindMemory() ||
+    buffer_memory.MapPersistently();
+    if (!pipeline_scatter)
+        CreatePipeline();
+
+    //每个目标缓冲区一个描述符集，ForgetDestinations()时释放
+    VkDescriptorPoolSize descriptorPoolSizes[] =
+    {
+        VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, maxDestinationCount },
+        VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxDestinationCount }
+    };
+    descriptor_pool.reset(new descriptorPool(maxDestinationCount, descriptorPoolSizes, VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT));
+}
+
+void bufferScatter::CreatePipeline()
+{
+    VkDescriptorSetLayoutBinding descriptorSetLayoutBindings[2] = {};
+    descriptorSetLayoutBindings[0].binding = 0; //记录，以动态偏移绑定当前帧的段
+    descriptorSetLayoutBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    descriptorSetLayoutBindings[0].descriptorCount = 1;
+    descriptorSetLayoutBindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    descriptorSetLayoutBindings[1].binding = 1; //目标缓冲区
+    descriptorSetLayoutBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorSetLayoutBindings[1].descriptorCount = 1;
+    descriptorSetLayoutBindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {};
+    descriptorSetLayoutCreateInfo.bindingCount = sizeof(descriptorSetLayoutBindings) / sizeof(VkDescriptorSetLayoutBinding);
+    descriptorSetLayoutCreateInfo.pBindings = descriptorSetLayoutBindings;
+    descriptorSetLayout_scatter.Create(descriptorSetLayoutCreateInfo);
+
+    //firstWord, recordCount, wordCountPerRecord, recordBase
+    VkPushConstantRange pushConstantRange = { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t) * 4 };
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+    pipelineLayoutCreateInfo.setLayoutCount = 1;
+    pipelineLayoutCreateInfo.pSetLayouts = descriptorSetLayout_scatter.Address();
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+    pipelineLayout_scatter.Create(pipelineLayoutCreateInfo);
+
+    QString shader = QString("%1/shader/ScatterUpdate.comp").arg(CODE_DIR);
+    QString output = QString("%1/ScatterUpdate.comp.spv").arg(APP_PATH);
+    compileShader(VK_GLSLC, shader, output);
+    shaderModule shaderModule_scatter(output.toStdString().c_str());
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.layout = pipelineLayout_scatter;
+    pipelineInfo.stage = shaderModule_scatter.StageCreateInfo(VK_SHADER_STAGE_COMPUTE_BIT);
+    pipelineInfo.basePipelineHandle = (VkPipeline)VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = -1;
+    pipeline_scatter.Create(pipelineInfo);
+}
+
+VkDescriptorSet bufferScatter::DescriptorSet(VkBuffer buffer_dst, VkDeviceSize range_dst)
+{
+    for (auto& i : descriptorSets)
+        if (i.first == buffer_dst)
+            return i.second;
+    if (descriptorSets.size() == maxDestinationCount) {
+        qDebug("[ bufferScatter ] ERROR\nToo many destination buffers!\nMax destination count: %u\n", maxDestinationCount);
+        return (VkDescriptorSet)VK_NULL_HANDLE;
+    }
+    descriptorSet set;
+    if (descriptor_pool->AllocateSets(set, descriptorSetLayout_scatter))
+        return (VkDescriptorSet)VK_NULL_HANDLE;
+    //VK_WHOLE_SIZE的实际范围可能超过maxStorageBufferRange，因此明确指定范围
+    VkDescriptorBufferInfo bufferInfos[2] = {
+        { buffer_memory.Buffer(), 0, sizePerFrame },
+        { buffer_dst, 0, range_dst }
+    };
+    set.write(bufferInfos[0], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 0);
+    set.write(bufferInfos[1], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1);
+    descriptorSets.emplace_back(buffer_dst, std::move(set));
+    return descriptorSets.back().second;
+}
+
+void bufferScatter::NextFrame()
+{
+    currentFrame = (currentFrame + 1) % frameCount;
+    head = sizePerFrame * currentFrame;
+}
+
+bool bufferScatter::Add(VkDeviceSize offset_dst, const void* pData_src, VkDeviceSize size)
+{
+    if (offset_dst % 4 || size % 4 || !size) {
+        qDebug("[ bufferScatter ] ERROR\nOffset and size must be non-zero multiples of 4!\nOffset: %llu\nSize: %llu\n",
+               (unsigned long long)offset_dst, (unsigned long long)size);
+        return false;
+    }
+    if (offsets.size() && size / 4 != wordCountPerRecord) {
+        qDebug("[ bufferScatter ] ERROR\nAll records in a batch must have the same size!\nExpected: %u bytes\nRequested: %llu bytes\n",
+               wordCountPerRecord * 4, (unsigned long long)size);
+        return false;
+    }
+    wordCountPerRecord = uint32_t(size / 4);
+    //同一批次中目标偏移相同的记录会被不同的调用同时写入，结果不确定，因此由后添加的记录覆盖先添加的
+    auto result = recordIndices.emplace(uint32_t(offset_dst / 4), uint32_t(offsets.size()));
+    if (!result.second) {
+        memcpy(&payloads[size_t(result.first->second) * wordCountPerRecord], pData_src, size_t(size));
+        return true;
+    }
+    offsets.push_back(uint32_t(offset_dst / 4));
+    size_t end = payloads.size();
+    payloads.resize(end + wordCountPerRecord);
+    memcpy(&payloads[end], pData_src, size_t(size));
+    return true;
+}
+
+void bufferScatter::Clear()
+{
+    offsets.clear();
+    payloads.clear();
+    recordIndices.clear();
+    wordCountPerRecord = 0;
+}
+
+void bufferScatter::ForgetDestinations()
+{
+    for (auto& i : descriptorSets)
+        descriptor_pool->FreeSets(i.second);
+    descriptorSets.clear();
+}
+
+bool bufferScatter::CmdScatter(VkCommandBuffer commandBuffer, VkBuffer buffer_dst, VkDeviceSize size_dst,
+                               VkPipelineStageFlags stage_from, VkAccessFlags access_from,
+                               VkPipelineStageFlags stage_to, VkAccessFlags access_to)
+{
+    if (offsets.empty())
+        return true;
+    VkDeviceSize size = sizeof(uint32_t) * (offsets.size() + payloads.size());
+    if (head + size > sizePerFrame * (currentFrame + 1)) {
+        qDebug("[ bufferScatter ] ERROR\nOut of space in the current frame!\nRequested: %llu bytes\n", (unsigned long long)size);
+        return false;
+    }
+#ifndef NDEBUG
+    //偏移不同但范围部分重叠的记录同样会竞争写入，Add(...)中不检查，仅在Debug下排序后检查
+    std::vector<uint32_t> offsets_sorted(offsets);
+    std::sort(offsets_sorted.begin(), offsets_sorted.end());
+    for (size_t i = 1; i < offsets_sorted.size(); i++)
+        if (offsets_sorted[i] - offsets_sorted[i - 1] < wordCountPerRecord) {
+            qDebug("[ bufferScatter ] ERROR\nRecords overlap!\nOffsets: %llu, %llu\nSize: %u bytes\n",
+                   (unsigned long long)offsets_sorted[i - 1] * 4, (unsigned long long)offsets_sorted[i] * 4, wordCountPerRecord * 4);
+            return false;
+        }
+#endif
+    //目标缓冲区的描述符范围被限制在maxStorageBufferRange以内，超出范围的记录无法写入
+    VkDeviceSize range_dst = std::min(size_dst, VkDeviceSize(graphicsBase::Base().PhysicalDeviceProperties().limits.maxStorageBufferRange));
+    VkDeviceSize end_dst = sizeof(uint32_t) * (VkDeviceSize(*std::max_element(offsets.begin(), offsets.end())) + wordCountPerRecord);
+    if (end_dst > range_dst) {
+        qDebug("[ bufferScatter ] ERROR\nRecords exceed the range of the destination buffer!\nEnd of records: %llu\nRange: %llu\n",
+               (unsigned long long)end_dst, (unsigned long long)range_dst);
+        return false;
+    }
+    VkDescriptorSet set = DescriptorSet(buffer_dst, range_dst);
+    if (!set)
+        return false;
+    //记录：|偏移 * recordCount|payload * recordCount|
+    uint8_t* pData_dst = static_cast<uint8_t*>(buffer_memory.MappedData()) + head;
+    memcpy(pData_dst, offsets.data(), sizeof(uint32_t) * offsets.size());
+    memcpy(pData_dst + sizeof(uint32_t) * offsets.size(), payloads.data(), sizeof(uint32_t) * payloads.size());
+    buffer_memory.FlushMappedMemoryRange(size, head);
+
+    //firstWord, recordCount, wordCountPerRecord, recordBase（相对于当前帧的段）
+    uint32_t dynamicOffset = uint32_t(sizePerFrame * currentFrame);
+    uint32_t pushConstants[4] = { 0, RecordCount(), wordCountPerRecord, uint32_t((head - dynamicOffset) / 4) };
+    head += size;
+
+    //等待之前对目标缓冲区的访问，写后读和读后写都需要
+    VkBufferMemoryBarrier bufferMemoryBarrier = {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        nullptr,
+        access_from,
+        VK_ACCESS_SHADER_WRITE_BIT,
+        VK_QUEUE_FAMILY_IGNORED,
+        VK_QUEUE_FAMILY_IGNORED,
+        buffer_dst,
+        0,
+        VK_WHOLE_SIZE
+    };
+    vkCmdPipelineBarrier(commandBuffer, stage_from, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+        0, nullptr, 1, &bufferMemoryBarrier, 0, nullptr);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_scatter);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout_scatter, 0, 1, &set, 1, &dynamicOffset);
+    //每个调用写入一个字，字数超过单次dispatch的工作组数上限时分多次dispatch
+    uint32_t wordCount = pushConstants[1] * pushConstants[2];
+    uint32_t maxWordCountPerDispatch = std::min(graphicsBase::Base().PhysicalDeviceProperties().limits.maxComputeWorkGroupCount[0],
+                                                UINT32_MAX / localSizeX) * localSizeX;
+    for (; pushConstants[0] < wordCount; pushConstants[0] += std::min(wordCount - pushConstants[0], maxWordCountPerDispatch)) {
+        vkCmdPushConstants(commandBuffer, pipelineLayout_scatter, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof pushConstants, pushConstants);
+        vkCmdDispatch(commandBuffer, (std::min(wordCount - pushConstants[0], maxWordCountPerDispatch) + localSizeX - 1) / localSizeX, 1, 1);
+    }
+
+    bufferMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    bufferMemoryBarrier.dstAccessMask = access_to;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, stage_to, 0,
+        0, nullptr, 1, &bufferMemoryBarrier, 0, nullptr);
+    Clear();
+    return true;
+}
+
+VkQueue submitBatch::Queue(queueType queue)
+{
+    switch (queue) {
+    case transfer: return graphicsBase::Base().Queue_Transfer();
+    case compute: return graphicsBase::Base().Queue_Compute();
+    default: return graphicsBase::Base().Queue_Graphics();
+    }
+}
+
+submitBatch::segment& submitBatch::Segment(VkQueue queue, arrayRef<const VkSemaphore> waitSemaphores)
+{
+    for (uint32_t i = segmentCount; i; i--) {
+        segment& segment_i = *segments[i - 1];
+        if (segment_i.queue == queue)
+            return segment_i;
+        //该段在queue的最后一段之后，若其置位了要等待的信号量，新的提交只能排在它之后
+        bool signalsWaited = false;
+        for (VkSemaphore semaphore_wait : waitSemaphores)
+            signalsWaited |= std::find(segment_i.signalSemaphores.begin(), segment_i.signalSemaphores.end(), semaphore_wait) != segment_i.signalSemaphores.end();
+        if (signalsWaited)
+            break;
+    }
+    if (segmentCount == segments.size())
+        segments.push_back(std::make_unique<segment>());
+    segment& segment_new = *segments[segmentCount++];
+    segment_new.queue = queue;
+    return segment_new;
+}
+
+void submitBatch::ClearSegments()
+{
+    for (uint32_t i = 0; i < segmentCount; i++)
+        segments[i]->submissions.clear(),
+        segments[i]->commandBuffers.clear(),
+        segments[i]->waitSemaphores.clear(),
+        segments[i]->waitDstStages.clear(),
+        segments[i]->signalSemaphores.clear();
+    segmentCount = 0;
+}
+
+uint32_t submitBatch::SubmitInfoCount(queueType queue) const
+{
+    VkQueue vkQueue = Queue(queue);
+    std::lock_guard<std::mutex> lock(mtx);
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < segmentCount; i++)
+        if (segments[i]->queue == vkQueue)
+            count += uint32_t(segments[i]->submissions.size());
+    return count;
+}
+
+bool submitBatch::Empty() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return !segmentCount;
+}
+
+bool submitBatch::Add(queueType queue, arrayRef<const VkCommandBuffer> commandBuffers,
+                      arrayRef<const VkSemaphore> waitSemaphores, arrayRef<const VkPipelineStageFlags> waitDstStages,
+                      arrayRef<const VkSemaphore> signalSemaphores)
+{
+    if (false ||
+        queue >= queueTypeCount ||
+        waitSemaphores.Count() != waitDstStages.Count()) {
+        qDebug("[ submitBatch ] ERROR\nInvalid queue type or mismatched wait semaphores and stages!\nQueue type: %u\nWait semaphore count: %llu\nStage count: %llu\n",
+               uint32_t(queue), (unsigned long long)waitSemaphores.Count(), (unsigned long long)waitDstStages.Count());
+        return false;
+    }
+    VkQueue vkQueue = Queue(queue);
+    if (!vkQueue) {
+        qDebug("[ submitBatch ] ERROR\nThe queue is not available!\nQueue type: %u\n", uint32_t(queue));
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    segment& segment_dst = Segment(vkQueue, waitSemaphores);
+    if (waitSemaphores.Count() || segment_dst.submissions.empty() || segment_dst.submissions.back().signalSemaphoreCount)
+        segment_dst.submissions.push_back({});
+    submission& submission_dst = segment_dst.submissions.back();
+    submission_dst.commandBufferCount += uint32_t(commandBuffers.Count());
+    submission_dst.waitSemaphoreCount += uint32_t(waitSemaphores.Count());
+    submission_dst.signalSemaphoreCount += uint32_t(signalSemaphores.Count());
+    segment_dst.commandBuffers.insert(segment_dst.commandBuffers.end(), commandBuffers.begin(), commandBuffers.end());
+    segment_dst.waitSemaphores.insert(segment_dst.waitSemaphores.end(), waitSemaphores.begin(), waitSemaphores.end());
+    segment_dst.waitDstStages.insert(segment_dst.waitDstStages.end(), waitDstStages.begin(), waitDstStages.end());
+    segment_dst.signalSemaphores.insert(segment_dst.signalSemaphores.end(), signalSemaphores.begin(), signalSemaphores.end());
+    return true;
+}
+
+result_t submitBatch::Flush(queueType queue, VkFence fence)
+{
+    VkQueue queue_fence = Queue(queue);
+    std::lock_guard<std::mutex> lock(mtx);
+    //栅栏随queue_fence的最后一段提交
+    uint32_t fenceSegmentIndex = UINT32_MAX;
+    for (uint32_t i = 0; i < segmentCount; i++)
+        if (segments[i]->queue == queue_fence)
+            fenceSegmentIndex = i;
+    VkResult result = VK_SUCCESS;
+    for (uint32_t i = 0; i < segmentCount; i++) {
+        segment& segment_src = *segments[i];
+        //在此之前vector可能扩容，指针须在提交前才填写
+        submitInfos.resize(segment_src.submissions.size());
+        uint32_t commandBufferIndex = 0, waitSemaphoreIndex = 0, signalSemaphoreIndex = 0;
+        for (size_t j = 0; j < segment_src.submissions.size(); j++) {
+            const submission& submission_src = segment_src.submissions[j];
+            VkSubmitInfo& submitInfo = submitInfos[j];
+            submitInfo = {};
+            submitInfo.waitSemaphoreCount = submission_src.waitSemaphoreCount;
+            submitInfo.pWaitSemaphores = segment_src.waitSemaphores.data() + waitSemaphoreIndex;
+            submitInfo.pWaitDstStageMask = segment_src.waitDstStages.data() + waitSemaphoreIndex;
+            submitInfo.commandBufferCount = submission_src.commandBufferCount;
+            submitInfo.pCommandBuffers = segment_src.commandBuffers.data() + commandBufferIndex;
+            submitInfo.signalSemaphoreCount = submission_src.signalSemaphoreCount;
+            submitInfo.pSignalSemaphores = segment_src.signalSemaphores.data() + signalSemaphoreIndex;
+            commandBufferIndex += submission_src.commandBufferCount;
+            waitSemaphoreIndex += submission_src.waitSemaphoreCount;
+            signalSemaphoreIndex += submission_src.signalSemaphoreCount;
+        }
+        VkResult result_segment = graphicsBase::Base().SubmitCommandBuffers(segment_src.queue,
+            arrayRef<VkSubmitInfo>(submitInfos.data(), submitInfos.size()), i == fenceSegmentIndex ? fence : (VkFence)VK_NULL_HANDLE);
+        if (!result)
+            result = result_segment;
+        //提交失败时栅栏不会被置位，之后以空提交置位，以免等待该栅栏（如frameContext::BeginFrame()）永远不返回
+        if (result_segment && i == fenceSegmentIndex)
+            fenceSegmentIndex = UINT32_MAX;
+    }
+    if (fence && fenceSegmentIndex == UINT32_MAX) {
+        VkResult result_fence = graphicsBase::Base().SubmitCommandBuffers(queue_fence, {}, fence);
+        if (!result)
+            result = result_fence;
+    }
+    //提交失败时同样丢弃，以免下一次重复提交
+    ClearSegments();
+    return result;
+}
+
+void submitBatch::Clear()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    ClearSegments();
+}
+
+frameContext::frameContext(uint32_t frameCount, VkDeviceSize transientUniformSizePerFrame)
+{
+    Create(frameCount, transientUniformSizePerFrame);
+}
+
+void frameContext::Create(uint32_t frameCount, VkDeviceSize transientUniformSizePerFrame)
+{
+    WaitAll();
+    frames.clear();
+    //呈现可能仍在等待这些信号量
+    for (auto& i : semaphores_renderingIsOver)
+        deferredDestructionQueue::Get().Push(i);
+    semaphores_renderingIsOver.clear();
+    frameCount = std::max(frameCount, 1u);
+    for (uint32_t i = 0; i < frameCount; i++) {
+        frames.push_back(std::make_unique<frame>());
+        frame& frame_new = *frames.back();
+        //整体重置命令池，不需要VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT；命令缓冲区每帧重新录制，指定TRANSIENT_BIT
+        false ||
+        frame_new.command_pool.Create(graphicsBase::Base().QueueFamilyIndex_Graphics(), VK_COMMAND_POOL_CREATE_TRANSIENT_BIT) ||
+        frame_new.command_pool.AllocateBuffers(frame_new.command_buffer);
+    }
+    currentFrame = 0;
+    if (transientUniformSizePerFrame)
+        transientUniforms.Create(transientUniformSizePerFrame, frameCount);
+    //第i帧推入的对象在第i + frameCount帧开始时（已等待第i帧的栅栏）销毁
+    deferredDestructionQueue::Get().FrameCount(frameCount);
+}
+
+result_t frameContext::BeginFrame()
+{
+    frame& frame_current = *frames[currentFrame];
+    //等待该帧上一次提交的命令执行完毕，其命令缓冲区和临时分配的资源才能重复使用
+    if (VkResult result = frame_current.fence_inFlight.Wait())
+        return result;
+    //先获取图像：失败时（如窗口最小化）调用者会重试BeginFrame()，此时栅栏不会被再次等待，故之前不能推进任何按帧轮换的东西
+    if (VkResult result = graphicsBase::Base().SwapImage(frame_current.semaphore_imageIsAvailable))
+        return result;
+    //交换链重建后图像数可能改变，多出的信号量可能仍被呈现等待，延迟销毁
+    uint32_t imageCount = graphicsBase::Base().SwapchainImageCount();
+    while (semaphores_renderingIsOver.size() > imageCount)
+        deferredDestructionQueue::Get().Push(semaphores_renderingIsOver.back()),
+        semaphores_renderingIsOver.pop_back();
+    while (semaphores_renderingIsOver.size() < imageCount)
+        semaphores_renderingIsOver.emplace_back();
+    deferredDestructionQueue::Get().NextFrame();
+    if (VkResult result = frame_current.command_pool.Reset())
+        return result;
+    frame_current.usedCounts[0] = frame_current.usedCounts[1] = 0;
+    if (transientUniforms.FrameCount())
+        transientUniforms.NextFrame();
+    return VK_SUCCESS;
+}
+
+VkCommandBuffer frameContext::AllocateCommandBuffer(VkCommandBufferLevel level)
+{
+    frame& frame_current = *frames[currentFrame];
+    std::vector<VkCommandBuffer>& commandBuffers = frame_current.commandBuffers[level];
+    uint32_t& usedCount = frame_current.usedCounts[level];
+    if (usedCount == commandBuffers.size()) {
+        VkCommandBuffer commandBuffer = (VkCommandBuffer)VK_NULL_HANDLE;
+        if (frame_current.command_pool.AllocateBuffers(commandBuffer, level))
+            return (VkCommandBuffer)VK_NULL_HANDLE;
+        commandBuffers.push_back(commandBuffer);
+    }
+    return commandBuffers[usedCount++];
+}
+
+result_t frameContext::EndFrame(VkPipelineStageFlags waitDstStage)
+{
+    return EndFrame(frames[currentFrame]->command_buffer, waitDstStage);
+}
+
+result_t frameContext::EndFrame(VkCommandBuffer commandBuffer, VkPipelineStageFlags waitDstStage)
+{
+    frame& frame_current = *frames[currentFrame];
+    if (transientUniforms.FrameCount())
+        transientUniforms.FlushFrame(mappedRanges);
+    mappedRanges.Flush();
+    VkSemaphore semaphore_imageIsAvailable = frame_current.semaphore_imageIsAvailable;
+    VkSemaphore semaphore_renderingIsOver = semaphores_renderingIsOver[graphicsBase::Base().CurrentImageIndex()];
+    submissions.Add(submitBatch::graphics, commandBuffer, semaphore_imageIsAvailable, waitDstStage, semaphore_renderingIsOver);
+    VkResult result = frame_current.fence_inFlight.Reset();
+    if (result)
+        submissions.Clear();
+    result ||
+    (result = submissions.Flush(frame_current.fence_inFlight)) ||
+    (result = graphicsBase::Base().PresentImage(semaphore_renderingIsOver));
+    currentFrame = (currentFrame + 1) % frames.size();
+    return result;
+}
+
+void frameContext::WaitAll() const
+{
+    for (auto& i : frames)
+        i->fence_inFlight.Wait();
+}
+
+parallelRecorder::parallelRecorder(uint32_t workerCount, uint32_t frameCount)
+{
+    Create(workerCount, frameCount);
+}
+
+void parallelRecorder::Create(uint32_t workerCount, uint32_t frameCount)
+{
+    Destroy();
+    if (!workerCount)
+        workerCount = std::max(std::thread::hardware_concurrency(), 1u);
+    frameCount = std::max(frameCount, 1u);
+    exiting = false;
+    pendingCount = 0;
+    //新的工作线程从jobIndex_done = 0开始，jobIndex不归零的话它们会把上次Create(...)后的最后一个任务当作新任务再执行一次
+    jobIndex = 0;
+    job = nullptr;
+    currentFrame = 0;
+    for (uint32_t i = 0; i < workerCount; i++) {
+        workers.push_back(std::make_unique<worker>());
+        worker& worker_new = *workers.back();
+        worker_new.pools.resize(frameCount);
+        worker_new.buffers.resize(frameCount);
+        //次级命令缓冲区每帧重新录制，整体重置命令池
+        for (auto& j : worker_new.pools)
+            j.Create(graphicsBase::Base().QueueFamilyIndex_Graphics(), VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+    }
+    //命令池创建完毕后再启动线程
+    for (uint32_t i = 0; i < workerCount; i++)
+        workers[i]->thread = std::thread(&parallelRecorder::WorkerLoop, this, i);
+}
+
+void parallelRecorder::Destroy()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        exiting = true;
+    }
+    condition_job.notify_all();
+    for (auto& i : workers)
+        if (i->thread.joinable())
+            i->thread.join();
+    //命令池销毁时释放其中的命令缓冲区，调用前须确保GPU不再使用它们
+    workers.clear();
+}
+
+void parallelRecorder::WorkerLoop(uint32_t workerIndex)
+{
+    uint64_t jobIndex_done = 0;
+    while (true) {
+        std::function<void(uint32_t)> job_current;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            condition_job.wait(lock, [&] { return exiting || jobIndex != jobIndex_done; });
+            if (exiting)
+                return;
+            jobIndex_done = jobIndex;
+            job_current = job;
+        }
+        job_current(workerIndex);
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!--pendingCount)
+            condition_done.notify_one();
+    }
+}
+
+void parallelRecorder::RunOnWorkers(std::function<void(uint32_t workerIndex)> job)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    this->job = std::move(job);
+    pendingCount = uint32_t(workers.size());
+    jobIndex++;
+    condition_job.notify_all();
+    condition_done.wait(lock, [&] { return !pendingCount; });
+}
+
+VkCommandBuffer parallelRecorder::SecondaryCommandBuffer(uint32_t workerIndex)
+{
+    worker& worker_current = *workers[workerIndex];
+    std::vector<VkCommandBuffer>& buffers = worker_current.buffers[currentFrame];
+    if (worker_current.usedCount == buffers.size()) {
+        VkCommandBuffer commandBuffer = (VkCommandBuffer)VK_NULL_HANDLE;
+        if (worker_current.pools[currentFrame].AllocateBuffers(commandBuffer, VK_COMMAND_BUFFER_LEVEL_SECONDARY))
+            return (VkCommandBuffer)VK_NULL_HANDLE;
+        buffers.push_back(commandBuffer);
+    }
+    return buffers[worker_current.usedCount++];
+}
+
+result_t parallelRecorder::BeginFrame(uint32_t frameIndex)
+{
+    currentFrame = frameIndex;
+    //工作线程此时空闲，由主线程重置各线程的命令池
+    for (auto& i : workers) {
+        i->usedCount = 0;
+        if (VkResult result = i->pools[frameIndex].Reset())
+            return result;
+    }
+    return VK_SUCCESS;
+}
+
+uint32_t parallelRecorder::CmdExecuteParallel(VkCommandBuffer commandBuffer_primary, VkRenderPass renderPass, uint32_t subpass, VkFramebuffer framebuffer,
+                                              uint32_t itemCount, const record_t& record, uint32_t minItemCountPerWorker)
+{
+    if (!itemCount || workers.empty())
+        return 0;
+    //每段的绘制数，段数不超过工作线程数
+    uint32_t segmentCount = std::min(WorkerCount(), std::max(itemCount / std::max(minItemCountPerWorker, 1u), 1u));
+    uint32_t itemCountPerSegment = (itemCount + segmentCount - 1) / segmentCount;
+    std::vector<VkCommandBuffer> secondaryCommandBuffers(segmentCount);
+    RunOnWorkers([&](uint32_t workerIndex) {
+        if (workerIndex >= segmentCount)
+            return;
+        uint32_t begin = workerIndex * itemCountPerSegment;
+        uint32_t end = std::min(begin + itemCountPerSegment, itemCount);
+        VkCommandBuffer commandBuffer = SecondaryCommandBuffer(workerIndex);
+        if (!commandBuffer)
+            return;
+        VkCommandBufferInheritanceInfo inheritanceInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+            nullptr,
+            renderPass,
+            subpass,
+            framebuffer
+        };
+        VkCommandBufferBeginInfo beginInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            nullptr,
+            VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+            &inheritanceInfo
+        };
+        if (VkResult result = vkBeginCommandBuffer(commandBuffer, &beginInfo)) {
+            qDebug("[ parallelRecorder ] ERROR\nFailed to begin a secondary command buffer!\nError code: %d\n", int32_t(result));
+            return;
+        }
+        if (begin < end)
+            record(commandBuffer, begin, end, workerIndex);
+        if (VkResult result = vkEndCommandBuffer(commandBuffer)) {
+            qDebug("[ parallelRecorder ] ERROR\nFailed to end a secondary command buffer!\nError code: %d\n", int32_t(result));
+            return;
+        }
+        secondaryCommandBuffers[workerIndex] = commandBuffer;
+    });
+    //join：按段的顺序执行，跳过录制失败的段
+    secondaryCommandBuffers.erase(std::remove(secondaryCommandBuffers.begin(), secondaryCommandBuffers.end(), (VkCommandBuffer)VK_NULL_HANDLE),
+                                  secondaryCommandBuffers.end());
+    if (secondaryCommandBuffers.size())
+        vkCmdExecuteCommands(commandBuffer_primary, uint32_t(secondaryCommandBuffers.size()), secondaryCommandBuffers.data());
+    return uint32_t(secondaryCommandBuffers.size());
+}
+
+recordedCommandBuffers::recordedCommandBuffers(record_t record)
+{
+    Create(std::move(record));
+}
+
+uint64_t recordedCommandBuffers::SwapchainGeneration()
+{
+    static uint64_t generation = 0;
+    static bool registered = false;
+    if (!registered)
+        graphicsBase::Base().AddCallback_CreateSwapchain([] { generation++; }),
+        registered = true;
+    return generation;
+}
+
+void recordedCommandBuffers::Create(record_t record)
+{
+    this->record = std::move(record);
+    Invalidate();
+}
+
+void recordedCommandBuffers::Invalidate()
+{
+    //命令池销毁时释放其中的命令缓冲区，须等到使用它们的帧执行完毕
+    if (command_pool)
+        deferredDestructionQueue::Get().Push(command_pool);
+    std::fill(commandBuffers.begin(), commandBuffers.end(), (VkCommandBuffer)VK_NULL_HANDLE);
+}
+
+VkCommandBuffer recordedCommandBuffers::CommandBuffer(uint32_t imageIndex)
+{
+    uint32_t imageCount = graphicsBase::Base().SwapchainImageCount();
+    if (swapchainGeneration != SwapchainGeneration() || commandBuffers.size() != imageCount)
+        Invalidate(),
+        commandBuffers.resize(imageCount),
+        swapchainGeneration = SwapchainGeneration();
+    if (imageIndex >= imageCount) {
+        qDebug("[ recordedCommandBuffers ] ERROR\nImage index out of range!\nImage index: %u\nImage count: %u\n", imageIndex, imageCount);
+        return (VkCommandBuffer)VK_NULL_HANDLE;
+    }
+    VkCommandBuffer& commandBuffer = commandBuffers[imageIndex];
+    if (commandBuffer)
+        return commandBuffer;
+    if (!command_pool &&
+        command_pool.Create(graphicsBase::Base().QueueFamilyIndex_Graphics()))
+        return (VkCommandBuffer)VK_NULL_HANDLE;
+    if (command_pool.AllocateBuffers(commandBuffer))
+        return commandBuffer = (VkCommandBuffer)VK_NULL_HANDLE;
+    VkCommandBufferBeginInfo beginInfo = {
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        nullptr,
+        VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT
+    };
+    VkResult result = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    if (result)
+        qDebug("[ recordedCommandBuffers ] ERROR\nFailed to begin a command buffer!\nError code: %d\n", int32_t(result));
+    else {
+        record(commandBuffer, imageIndex);
+        if ((result = vkEndCommandBuffer(commandBuffer)))
+            qDebug("[ recordedCommandBuffers ] ERROR\nFailed to end a command buffer!\nError code: %d\n", int32_t(result));
+    }
+    if (result) {
+        command_pool.FreeBuffers(commandBuffer);
+        return commandBuffer = (VkCommandBuffer)VK_NULL_HANDLE;
+    }
+    recordCount++;
+    return commandBuffer;
+}
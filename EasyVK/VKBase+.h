@@ -3,6 +3,8 @@
 
 #include "VKBase.h"
 #include "VKFormat.h"
+#include "VKLayout.h"
+#include "VKMesh.h"
 
 namespace vulkan {
 
@@ -12,8 +14,17 @@ namespace vulkan {
         commandPool commandPool_graphics;
         commandPool commandPool_presentation;
         commandPool commandPool_compute;
+        commandPool commandPool_transfer; //仅在有专用的传输队列族时创建
         commandBuffer commandBuffer_transfer; //从commandPool_graphics分配
+        commandBuffer commandBuffer_transferQueue; //从commandPool_transfer分配
         commandBuffer commandBuffer_presentation;
+        //在图形队列上获取所有权的提交，按提交顺序排列，栅栏置位后其命令缓冲区和信号量可再用
+        struct ownershipAcquire {
+            commandBuffer command_buffer; //从commandPool_graphics分配
+            fence fence_acquired;
+            semaphore semaphore_transferIsOver;
+        };
+        mutable std::deque<std::unique_ptr<ownershipAcquire>> ownershipAcquires;
 
         //单例
         static graphicsBasePlus singleton;
@@ -27,9 +38,17 @@ namespace vulkan {
         const commandPool& CommandPool_Graphics() const { return commandPool_graphics; }
         const commandPool& CommandPool_Compute() const { return commandPool_compute; }
         const commandBuffer& CommandBuffer_Transfer() const { return commandBuffer_transfer; }
+        //用于提交到传输队列的命令缓冲区，没有专用的传输队列族时即CommandBuffer_Transfer()
+        const commandBuffer& CommandBuffer_TransferQueue() const {
+            return graphicsBase::Base().HasDedicatedTransferQueue() ? commandBuffer_transferQueue : commandBuffer_transfer;
+        }
 
         //简化命令提交
         result_t ExecuteCommandBuffer_Graphics(VkCommandBuffer commandBuffer) const;
+        //提交CommandBuffer_TransferQueue()中录制的命令并等待完成
+        //若有专用的传输队列族，commandBuffer中须在末尾录制释放所有权的屏障，acquireBarriers为对应的获取所有权的屏障，会在图形队列上执行
+        //获取所有权的提交等待传输置位的信号量，CPU只等待传输完成，不等待图形队列：图形队列上之后的提交在提交顺序上都位于获取之后
+        result_t ExecuteCommandBuffer_Transfer(VkCommandBuffer commandBuffer, arrayRef<const VkBufferMemoryBarrier> acquireBarriers = {}) const;
 
         //该函数专用于向呈现队列提交用于接收交换链图像的队列族所有权的命令缓冲区
         result_t AcquireImageOwnership_Presentation(VkSemaphore semaphore_renderingIsOver, VkSemaphore semaphore_ownershipIsTransfered, VkFence fence = (VkFence)VK_NULL_HANDLE) const;
@@ -106,6 +125,77 @@ namespace vulkan {
         }
     };
 
+    class uploadBatch;
+
+/*暂存环形缓冲区：供多个线程并发上传数据，每个线程使用各自的stagingRing
+    - 一个持久映射的host visible缓冲区被当作环形缓冲区使用，Allocate(...)只是移动写入位置
+    - 自上一次EndBatch()以来的分配构成一批，EndBatch()返回一个未置位的栅栏，提交该批拷贝命令时须使用这个栅栏
+    - 栅栏置位后，该批占用的区域被回收；空间不足时先回收已完成的批次，仍不足则等待最早的批次
+    - ThisThread()返回当前线程的stagingRing（首次调用时创建），线程退出时释放该线程的，逻辑设备销毁时全部释放
+
+    |----已回收----|==批次0(fence0)==|==批次1(fence1)==|--当前批次--|----空闲----|
+                   ^tail                                            ^head
+ */
+    class stagingRing {
+        struct batch {
+            VkDeviceSize end;            //该批次结束时的head
+            std::unique_ptr<fence> pFence;
+        };
+        bufferMemory buffer_memory;
+        VkDeviceSize capacity = 0;
+        //以下位置均为单调递增的字节数，对capacity取余得到在缓冲区中的位置
+        VkDeviceSize head = 0;
+        VkDeviceSize tail = 0;
+        VkDeviceSize batchBegin = 0;
+        std::deque<batch> batches;
+        std::vector<std::unique_ptr<fence>> freeFences;
+        //--------------------
+        //回收已完成的批次，wait为true时至少回收一个批次（若有）
+        void Recycle(bool wait);
+        //各线程的stagingRing，逻辑设备销毁时清空
+        struct threadRings {
+            std::unordered_map<std::thread::id, std::unique_ptr<stagingRing>> rings;
+            std::mutex mtx;
+            threadRings();
+        };
+        static threadRings& ThreadRings() {
+            static threadRings& singleton = *new threadRings;
+            return singleton;
+        }
+    public:
+        stagingRing() = default;
+        stagingRing(VkDeviceSize size);
+        stagingRing(stagingRing&&) = delete;
+        //Getter
+        operator VkBuffer() const { return buffer_memory.Buffer(); }
+        const VkBuffer* Address() const { return buffer_memory.AddressOfBuffer(); }
+        VkDeviceSize Capacity() const { return capacity; }
+        //当前的写入位置，EndBatch()后即该批次的结束位置，可用于IsComplete(...)和Wait(...)
+        VkDeviceSize Head() const { return head; }
+        //Non-const Function
+        void Create(VkDeviceSize size);
+        //分配size个字节，offset接收其在缓冲区中的位置；单次分配不能超过容量，当前批次占满整个缓冲区时返回nullptr
+        void* Allocate(VkDeviceSize size, VkDeviceSize& offset, VkDeviceSize alignment = 16);
+        //写入数据并返回其在缓冲区中的位置，失败时返回VK_WHOLE_SIZE
+        VkDeviceSize BufferData(const void* pData_src, VkDeviceSize size, VkDeviceSize alignment = 16);
+        //结束当前批次，刷新写入的数据（若非host coherent），返回的栅栏须用于提交该批次的命令
+        VkFence EndBatch();
+        //回收已完成的批次，不等待
+        void Recycle() { Recycle(false); }
+        //等待所有批次完成，通常不需要调用
+        void WaitAll();
+        //position之前的所有批次是否都已完成，position为某次EndBatch()后Head()的返回值
+        bool IsComplete(VkDeviceSize position);
+        //等待position之前的所有批次完成
+        void Wait(VkDeviceSize position);
+
+        //Static Function
+        //返回当前线程的stagingRing，首次调用时以defaultSize创建
+        static stagingRing& ThisThread(VkDeviceSize defaultSize = 16 << 20);
+        //等待当前线程的stagingRing上的批次完成后将其释放，之后的ThisThread()会重新创建；线程退出时自动调用
+        static void ReleaseThisThread();
+    };
+
 /*设备本地缓冲区：
     - 从具有 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT 属性的内存中分配
     - 针对 GPU 访问进行了优化
@@ -114,7 +204,21 @@ namespace vulkan {
  */
     class deviceLocalBuffer {
     protected:
+        //脏区间[begin, end)，按begin排序，互不相交也不相邻
+        struct dirtyRange {
+            VkDeviceSize begin;
+            VkDeviceSize end;
+        };
         bufferMemory buffer_memory;
+        VkDeviceSize size = 0;
+        std::unique_ptr<uint8_t[]> shadowData; //CPU端的影子副本，EnableShadow()后才有
+        std::vector<dirtyRange> dirtyRanges;   //影子副本中自上次Sync(...)以来被修改的区间
+        //若有专用的传输队列族，录制将[offset, offset + size)的所有权从传输队列族释放给图形队列族的屏障，返回该屏障供获取所有权时使用
+        VkBufferMemoryBarrier CmdReleaseOwnership_Transfer(VkCommandBuffer commandBuffer, VkDeviceSize offset, VkDeviceSize size) const;
+        //在已提交到传输队列的拷贝之后转移所有权（若需要）并等待完成
+        void ExecuteOwnershipTransfer(VkDeviceSize offset, VkDeviceSize size) const;
+        //将主线程暂存缓冲区开头的size个字节拷贝到offset处并等待完成
+        void CopyFromStaging_MainThread(VkDeviceSize size, VkDeviceSize offset) const;
     public:
         deviceLocalBuffer() = default;
         deviceLocalBuffer(VkDeviceSize size, VkBufferUsageFlags desiredUsages_Without_transfer_dst);
@@ -122,10 +226,39 @@ namespace vulkan {
         operator VkBuffer() const { return buffer_memory.Buffer(); }
         const VkBuffer* Address() const { return buffer_memory.AddressOfBuffer(); }
         VkDeviceSize AllocationSize() const { return buffer_memory.AllocationSize(); }
+        VkDeviceSize Size() const { return size; }
+        //缓冲区在着色器中的地址，须以VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT创建（见graphicsBase::BufferDeviceAddressEnabled()），Recreate(...)后地址改变
+        VkDeviceAddress DeviceAddress() const { return buffer_memory.DeviceAddress(); }
+        uint8_t* Shadow() { return shadowData.get(); }
+        const uint8_t* Shadow() const { return shadowData.get(); }
+        bool IsDirty() const { return dirtyRanges.size(); }
         //Non-const Function
-        void Create(VkDeviceSize size, VkBufferUsageFlags desiredUsages_Without_transfer_dst);
+        result_t Create(VkDeviceSize size, VkBufferUsageFlags desiredUsages_Without_transfer_dst);
+        //旧的缓冲区移入deferredDestructionQueue，不阻塞GPU；若启用了影子副本，保留其内容并在下次Sync(...)时重新上传
         void Recreate(VkDeviceSize size, VkBufferUsageFlags desiredUsages_Without_transfer_dst);
 
+        /*影子副本：在CPU端保留一份缓冲区的内容，记录被修改的区间，Sync(...)时只上传这些区间
+         *  Write(...)/MarkDirty(...)     Sync(commandBuffer, batch)
+         *  |..|###|.|##|........|#|..|  ->  |..|######|........|#|..|  间隔不超过mergeDistance的区间被合并为一次拷贝
+         */
+        //启用影子副本，缓冲区的大小须为4的倍数（vkCmdUpdateBuffer(...)的要求），副本初始为0且不标记为脏
+        bool EnableShadow();
+        //写入影子副本并标记为脏，须先EnableShadow()；没有影子副本或越界时报错并返回false
+        bool Write(const void* pData_src, VkDeviceSize size, VkDeviceSize offset = 0);
+        template<typename T>
+        bool Write(const T& data_src, VkDeviceSize offset = 0) {
+            return Write(&data_src, sizeof(T), offset);
+        }
+        //直接修改Shadow()后，用该函数标记被修改的区间，区间按4字节对齐扩展；没有影子副本或越界时报错并返回false
+        bool MarkDirty(VkDeviceSize offset, VkDeviceSize size);
+        //上传所有脏区间，返回拷贝区域的个数；无论内存是否host visible，写入都在命令执行时才发生，不与仍在执行的帧竞争
+        //不大于syncUpdateSizeLimit的区间为commandBuffer中的一条vkCmdUpdateBuffer(...)命令，数据在录制时即被复制，
+        //须在渲染通道外录制，与之前和之后对缓冲区的访问之间的屏障由使用者负责（同CmdUpdateBuffer(...)）
+        //更大的区间经batch（其stagingRing）拷贝，不另建暂存缓冲区；batch中在拷贝前录制了等待之前所有命令的屏障，
+        //须在commandBuffer之前提交到图形队列（batch以transferQueue = false创建），commandBuffer中的屏障的第一同步范围因而也覆盖这些拷贝
+        uint32_t Sync(VkCommandBuffer commandBuffer, uploadBatch& batch, VkDeviceSize mergeDistance = 256);
+        static constexpr VkDeviceSize syncUpdateSizeLimit = 4096;
+
         //内存暂存区->设备内存区 有以下两种
         //1.若数据量不大于65536个字节，用vkCmdUpdateBuffer(...)命令直接更新缓冲区
         void CmdUpdateBuffer(VkCommandBuffer commandBuffer, const void* pData_src, VkDeviceSize size_Limited_to_65536, VkDeviceSize offset = 0) const;
@@ -143,6 +276,30 @@ namespace vulkan {
         void TransferData(const T& data_src) const {
             TransferData(&data_src, sizeof(T));
         }
+        //3.将拷贝命令录制到uploadBatch中，与其他上传一同提交，不等待完成
+        void TransferData(uploadBatch& batch, const void* pData_src, VkDeviceSize size, VkDeviceSize offset = 0) const;
+        //4.按Layout（glslStruct<...>）描述的std140/std430布局，将count个C++结构体写入offset处，不经过中间的数组
+        //启用了影子副本时写入影子副本并标记为脏（之后Sync(...)），host visible时直接写入映射的内存，否则打包到临时数组后TransferData(...)
+        template<typename Layout, typename CppStruct>
+        void PackData(const CppStruct* pData_src, size_t count, VkDeviceSize offset = 0) {
+            VkDeviceSize size = Layout::size * count;
+            if (shadowData) {
+                if (MarkDirty(offset, size))
+                    Layout::Pack(shadowData.get() + offset, pData_src, count);
+            }
+            else if (buffer_memory.MemoryProperties() & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+                void* pData_dst = nullptr;
+                if (buffer_memory.MapMemory(pData_dst, size, offset))
+                    return;
+                Layout::Pack(pData_dst, pData_src, count);
+                buffer_memory.UnmapMemory(size, offset);
+            }
+            else {
+                std::unique_ptr<uint8_t[]> pData_packed(new uint8_t[size_t(size)]());
+                Layout::Pack(pData_packed.get(), pData_src, count);
+                TransferData(pData_packed.get(), size, offset);
+            }
+        }
     };
 
     //为顶点缓冲区创建专用的类型，vertexBuffer继承deviceLocalBuffer，在创建缓冲区时默认指定VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
@@ -152,15 +309,34 @@ namespace vulkan {
         vertexBuffer(VkDeviceSize size,VkBufferUsageFlags otherUsages = 0);
         void Create(VkDeviceSize size,VkBufferUsageFlags otherUsages = 0);
         void Recreate(VkDeviceSize size, VkBufferUsageFlags otherUsages = 0);
+        //按quantizer将vertexCount个间隔为stride_src的顶点量化后写入offset处（host visible时直接写入映射的内存，否则量化到临时数组后TransferData(...)），缓冲区的大小须不小于quantizer.Stride() * vertexCount
+        void TransferQuantized(const vertexQuantizer& quantizer, const void* pData_src, VkDeviceSize stride_src, uint32_t vertexCount, VkDeviceSize offset = 0) const;
     };
 
     //为索引缓冲区创建专用的类型，indexBuffer继承deviceLocalBuffer，在创建缓冲区时默认指定VK_BUFFER_USAGE_INDEX_BUFFER_BIT
     class indexBuffer : public deviceLocalBuffer{
+        VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+        uint32_t indexCount = 0;
     public:
         indexBuffer() = default;
         indexBuffer(VkDeviceSize size, VkBufferUsageFlags otherUsages = 0);
+        //Getter
+        //TransferIndices(...)所选的索引类型和写入的索引数量
+        VkIndexType IndexType() const { return indexType; }
+        uint32_t IndexCount() const { return indexCount; }
+        //Const Function
+        void CmdBind(VkCommandBuffer commandBuffer, VkDeviceSize offset = 0) const {
+            vkCmdBindIndexBuffer(commandBuffer, *this, offset, indexType);
+        }
+        //Non-const Function
         void Create(VkDeviceSize size,VkBufferUsageFlags otherUsages = 0);
         void Recreate(VkDeviceSize size, VkBufferUsageFlags otherUsages = 0);
+        //上传32位索引，vertexCount小于0xffff时先转为16位索引再经TransferData(...)上传，索引缓冲区的大小随之减半
+        //缓冲区不够大时（重新）创建，返回所选的索引类型；可先用OptimizeMesh(...)优化索引和顶点（见VKMesh.h）
+        VkIndexType TransferIndices(const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount, VkBufferUsageFlags otherUsages = 0);
+        VkIndexType TransferIndices(const meshData& mesh, VkBufferUsageFlags otherUsages = 0) {
+            return TransferIndices(mesh.indices.data(), mesh.IndexCount(), mesh.VertexCount(), otherUsages);
+        }
     };
 
     //为uniform缓冲区创建专用的类型，uniformBuffer继承deviceLocalBuffer，在创建缓冲区时默认指定VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT
@@ -173,6 +349,64 @@ namespace vulkan {
         //uniform缓冲与其他缓冲不同,该缓冲的长度必须是物理设备（GPU）要求的整数倍(该值可以从物理设备属性中提取)
         static VkDeviceSize CalculateAlignedSize(VkDeviceSize dataSize);
     };
+
+    /*uniformRingBuffer: 每帧线性分配的动态uniform缓冲区（配合VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC使用）
+     * 1.一个持久映射的缓冲区被均分为frameCount段，每段对应一帧，段的大小按CalculateAlignedSize(...)对齐
+     * 2.每帧开始时调用NextFrame()切换到下一段，帧内的每次Push(...)只是移动指针并memcpy(...)，返回值即vkCmdBindDescriptorSets(...)所需的dynamic offset
+     * 3.切换到某一段前，须确保使用该段的那一帧已执行完毕（即等待了该帧的栅栏），因此frameCount应不小于同时处理的帧数
+     *
+     *  | frame 0 | frame 1 | frame 2 |
+     *  |ubo|ubo|.|ubo|.....|.........|
+     *            ^head
+     */
+    class uniformRingBuffer {
+        bufferMemory buffer_memory;
+        VkDeviceSize sizePerFrame = 0;
+        uint32_t frameCount = 0;
+        uint32_t currentFrame = 0;
+        VkDeviceSize head = 0; //当前帧中下一次分配的起始位置，相对于缓冲区起始
+    public:
+        uniformRingBuffer() = default;
+        uniformRingBuffer(VkDeviceSize sizePerFrame, uint32_t frameCount = 2);
+        //Getter
+        operator VkBuffer() const { return buffer_memory.Buffer(); }
+        const VkBuffer* Address() const { return buffer_memory.AddressOfBuffer(); }
+        VkDeviceSize SizePerFrame() const { return sizePerFrame; }
+        uint32_t FrameCount() const { return frameCount; }
+        uint32_t CurrentFrame() const { return currentFrame; }
+        //Const Function
+        //该函数返回写入描述符时需要的信息，range为着色器中uniform块的大小
+        VkDescriptorBufferInfo DescriptorBufferInfo(VkDeviceSize range) const {
+            return { buffer_memory.Buffer(), 0, range };
+        }
+        //对于非host coherent的内存，在提交命令缓冲区前刷新当前帧写入的数据
+        void FlushFrame() const;
+        //同上，但只将当前帧写入的内存区记录到batch中，与其他内存区一同刷新
+        void FlushFrame(mappedMemoryRangeBatch& batch) const;
+        //Non-const Function
+        void Create(VkDeviceSize sizePerFrame, uint32_t frameCount = 2);
+        //切换到下一帧的那一段，并将该段清空
+        void NextFrame();
+        //在当前帧中分配size个字节，返回写入的地址，dynamicOffset接收dynamic offset，空间不足时返回nullptr
+        void* Allocate(VkDeviceSize size, uint32_t& dynamicOffset);
+        //写入数据并返回dynamic offset，空间不足时返回UINT32_MAX
+        uint32_t Push(const void* pData_src, VkDeviceSize size);
+        template<typename T>
+        uint32_t Push(const T& data_src) {
+            return Push(&data_src, sizeof(T));
+        }
+        //按Layout（glslStruct<...>）描述的std140布局写入count个C++结构体，返回dynamic offset，空间不足时返回UINT32_MAX
+        template<typename Layout, typename CppStruct>
+        uint32_t PushPacked(const CppStruct* pData_src, size_t count = 1) {
+            uint32_t dynamicOffset;
+            void* pData_dst = Allocate(Layout::size * count, dynamicOffset);
+            if (!pData_dst)
+                return UINT32_MAX;
+            Layout::Pack(pData_dst, pData_src, count);
+            return dynamicOffset;
+        }
+    };
+
     /*为storage缓冲区创建专用的类型，storageBuffer继承deviceLocalBuffer，在创建缓冲区时默认指定VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
      * 以下场景会用到storage buffer
      *  GPU 生成数据
@@ -187,6 +421,7 @@ namespace vulkan {
      *      1.读取计算结果
      *      2.调试数据
      *      3.离线处理结果
+     *  以VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT创建时，可将DeviceAddress()经push constant传给着色器（GL_EXT_buffer_reference），不需要描述符
      */
     class storageBuffer : public deviceLocalBuffer{
     public:
@@ -198,6 +433,80 @@ namespace vulkan {
         static VkDeviceSize CalculateAlignedSize(VkDeviceSize dataSize);
     };
 
+/*GPU上可增长的数组：元素存放在deviceLocalBuffer中，容量不足时按2倍扩张
+    - 扩张时用vkCmdCopyBuffer(...)将旧缓冲区中的元素拷贝到新缓冲区，不需要CPU重新上传，旧缓冲区移入deferredDestructionQueue
+    - Erase(...)在GPU上移动尾部的元素，源与目标重叠时借用空闲的容量中转，容量不足时经临时缓冲区中转
+    - 各操作在图形队列上执行并等待完成，操作前等待之前提交的所有命令对缓冲区的写入
+
+    |e0|e1|e2|e3|e4|.....|  Append(e5) (容量不足)  ->  |e0|e1|e2|e3|e4|e5|...........|
+     \___ Size() ___/                                   \__ vkCmdCopyBuffer __/
+     \_____ Capacity() ____/
+ */
+    class gpuVectorBase :protected deviceLocalBuffer {
+    protected:
+        VkBufferUsageFlags usages = 0;
+        VkDeviceSize elementSize = 0;
+        size_t count = 0;
+        size_t capacity = 0;
+        //--------------------
+        gpuVectorBase() = default;
+        gpuVectorBase(VkDeviceSize elementSize, VkBufferUsageFlags desiredUsages_Without_transfer, size_t capacity);
+        result_t Create(VkDeviceSize elementSize, VkBufferUsageFlags desiredUsages_Without_transfer, size_t capacity);
+        //将缓冲区换成容量为newCapacity的新缓冲区，并在GPU上拷贝已有的元素；创建失败时报错并保留旧缓冲区
+        result_t Reallocate(size_t newCapacity);
+        //扩张失败时不追加
+        void Append(const void* pData_src, size_t appendCount);
+        void Update(size_t index, const void* pData_src, size_t updateCount) const;
+    public:
+        //Getter
+        using deviceLocalBuffer::operator VkBuffer;
+        using deviceLocalBuffer::Address;
+        //扩张后地址改变
+        using deviceLocalBuffer::DeviceAddress;
+        size_t Size() const { return count; }
+        size_t Capacity() const { return capacity; }
+        bool Empty() const { return !count; }
+        VkDeviceSize SizeInBytes() const { return elementSize * count; }
+        //Const Function
+        VkDescriptorBufferInfo DescriptorBufferInfo() const {
+            return { buffer_memory.Buffer(), 0, count ? SizeInBytes() : VK_WHOLE_SIZE };
+        }
+        //Non-const Function
+        //确保容量不小于capacity，扩张时至少扩张到原来的2倍；失败时容量和元素不变
+        result_t Reserve(size_t capacity);
+        //删除从index开始的eraseCount个元素，之后的元素前移，保持顺序
+        void Erase(size_t index, size_t eraseCount = 1);
+        //只清空元素个数，不释放缓冲区
+        void Clear() { count = 0; }
+    };
+
+    //元素为T的gpuVectorBase，T须可平凡拷贝
+    template<typename T>
+    class gpuVector :public gpuVectorBase {
+        static_assert(std::is_trivially_copyable<T>::value, "The element type of a gpuVector must be trivially copyable!");
+    public:
+        gpuVector() = default;
+        gpuVector(VkBufferUsageFlags desiredUsages_Without_transfer, size_t capacity = 0) :
+            gpuVectorBase(sizeof(T), desiredUsages_Without_transfer, capacity) {}
+        //Non-const Function
+        result_t Create(VkBufferUsageFlags desiredUsages_Without_transfer, size_t capacity = 0) {
+            return gpuVectorBase::Create(sizeof(T), desiredUsages_Without_transfer, capacity);
+        }
+        void Append(const T& element) {
+            gpuVectorBase::Append(&element, 1);
+        }
+        void Append(const T* pData_src, size_t appendCount) {
+            gpuVectorBase::Append(pData_src, appendCount);
+        }
+        void Append(arrayRef<const T> elements) {
+            gpuVectorBase::Append(elements.Pointer(), elements.Count());
+        }
+        //覆盖从index开始的已有元素
+        void Update(size_t index, const T* pData_src, size_t updateCount = 1) const {
+            gpuVectorBase::Update(index, pData_src, updateCount);
+        }
+    };
+
 /*封装texture类，用于load file或Memory数据(贴图基类)
  * 一个完整的纹理包含: imageView、imageMemory(VkImage+VkDeviceMemory)、sample
 */
@@ -358,6 +667,7 @@ namespace vulkan {
             const VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED; //old layout 或 new layout
             imageMemoryBarrierParameterPack() = default;
             imageMemoryBarrierParameterPack(VkPipelineStageFlags s,VkAccessFlags a,VkImageLayout l):
+                isNeeded(true),
                 stage(s),
                 access(a),
                 layout(l){}
@@ -426,6 +736,65 @@ namespace vulkan {
                                      &imageMemoryBarrier);
             }
         }
+        //将图像拷贝到缓冲区(用于回读，拷贝前图像layout转为transfer src，拷贝后转为imb_to.layout)
+        static void  CmdCopyImageToBuffer(VkCommandBuffer commandBuffer, //命令缓冲区
+                                          VkImage image,//作为数据源的图像
+                                          VkBuffer buffer,//接受数据的缓冲区
+                                          const VkBufferImageCopy&  region, //指定将图像的哪些部分拷贝到缓冲区的哪些部分
+                                          imageMemoryBarrierParameterPack imb_from,
+                                          imageMemoryBarrierParameterPack imb_to){
+
+            VkImageMemoryBarrier imageMemoryBarrier{
+                VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                nullptr,
+                imb_from.access,
+                VK_ACCESS_TRANSFER_READ_BIT,
+                imb_from.layout,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                VK_QUEUE_FAMILY_IGNORED,
+                VK_QUEUE_FAMILY_IGNORED,
+                image,
+                VkImageSubresourceRange{
+                    region.imageSubresource.aspectMask,
+                    region.imageSubresource.mipLevel,
+                    1,
+                    region.imageSubresource.baseArrayLayer,
+                    region.imageSubresource.layerCount
+                }
+            };
+            //拷贝前需管线屏障
+            if(imb_from.isNeeded){
+                vkCmdPipelineBarrier(commandBuffer,
+                                     imb_from.stage,
+                                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     0,
+                                     0,
+                                     nullptr,
+                                     0,
+                                     nullptr,
+                                     1,
+                                     &imageMemoryBarrier);
+            }
+            vkCmdCopyImageToBuffer(commandBuffer,image,VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,buffer,1,&region);
+
+            //拷贝只读取图像，拷贝后的屏障只需执行依赖和布局转换
+            if(imb_to.isNeeded){
+                imageMemoryBarrier.srcAccessMask = 0;
+                imageMemoryBarrier.dstAccessMask = imb_to.access;
+                imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+                imageMemoryBarrier.newLayout = imb_to.layout;
+                vkCmdPipelineBarrier(commandBuffer,
+                                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     imb_to.stage,
+                                     0,
+                                     0,
+                                     nullptr,
+                                     0,
+                                     nullptr,
+                                     1,
+                                     &imageMemoryBarrier);
+            }
+        }
         //blit图像(只能image->image 且image layout还是transfer，如果需要渲染<layout转成attachment -- 给render_pass使用>或者显示<layout转成present -- 给交换链呈现>)
         static void CmdBlitImage(VkCommandBuffer commandBuffer, //命令缓冲区
                                  VkImage image_src,//数据源图像
@@ -443,7 +812,7 @@ namespace vulkan {
                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                 VK_QUEUE_FAMILY_IGNORED,
                 VK_QUEUE_FAMILY_IGNORED,
-                image_src,
+                image_dst,
                 VkImageSubresourceRange{
                     region.dstSubresource.aspectMask,
                     region.dstSubresource.mipLevel,
@@ -495,9 +864,425 @@ namespace vulkan {
             }
         }
     };
+
+/*上传批处理：将多个缓冲区和图像的上传录制到同一命令缓冲区，一次提交，不等待完成
+    - 数据经由stagingRing暂存，拷贝命令录制到自有命令池分配的命令缓冲区
+    - Submit()提交到图形队列（或传输队列）并返回ticket，可用IsComplete()轮询或用Wait()等待
+    - 每次提交的末尾有一个TRANSFER_WRITE到任何访问的内存屏障，之后提交到同一队列的命令可直接使用数据，不必等待ticket
+    - 已完成的命令缓冲区被回收再用；uploadBatch与其stagingRing应在同一线程中使用
+    - 超过ChunkSize()的数据被分块，每块单独提交，CPU写入第N+1块时GPU拷贝第N块，暂存区占用不随数据量增长
+
+    CopyBuffer(A) CopyBuffer(B) CopyBufferToImage(C) ... Submit() -> ticket
+                    \_______ 一个命令缓冲区, 一次vkQueueSubmit _______/
+
+    CopyBuffer(大块数据): |memcpy 0|memcpy 1|memcpy 2|memcpy 3|(等待块0)memcpy 4|...
+                                   |GPU拷贝0|GPU拷贝1|GPU拷贝2|GPU拷贝3        |...
+ */
+    class uploadBatch {
+    public:
+        class ticket {
+            stagingRing* pStagingRing = nullptr;
+            VkDeviceSize position = 0;
+        public:
+            ticket() = default;
+            ticket(stagingRing& ring, VkDeviceSize position) :pStagingRing(&ring), position(position) {}
+            //Const Function
+            bool IsComplete() const { return !pStagingRing || pStagingRing->IsComplete(position); }
+            void Wait() const { if (pStagingRing) pStagingRing->Wait(position); }
+        };
+    private:
+        struct submission {
+            VkDeviceSize position;
+            VkCommandBuffer commandBuffer;
+        };
+        stagingRing& staging_ring;
+        bool onTransferQueue;
+        commandPool command_pool;
+        VkCommandBuffer currentCommandBuffer = (VkCommandBuffer)VK_NULL_HANDLE;
+        std::deque<submission> submissions;
+        std::vector<VkCommandBuffer> freeCommandBuffers;
+        //--------------------
+        void RecycleCommandBuffers();
+        //在stagingRing中分配，当前批次占满stagingRing时先提交再重试，失败时返回nullptr
+        void* AllocateStaging(VkDeviceSize size, VkDeviceSize& offset, VkDeviceSize alignment = 16);
+    public:
+        //同时在stagingRing中的分块数
+        static constexpr VkDeviceSize chunkCount = 4;
+        //transferQueue为true时提交到传输队列，此时若有专用的传输队列族，使用者须自行转移资源的所有权
+        uploadBatch(stagingRing& ring = stagingRing::ThisThread(), bool transferQueue = false);
+        uploadBatch(uploadBatch&&) = delete;
+        ~uploadBatch();
+        //Getter
+        bool Empty() const { return !currentCommandBuffer; }
+        VkDeviceSize ChunkSize() const { return staging_ring.Capacity() / chunkCount; }
+        //Non-const Function
+        //该函数返回正在录制的命令缓冲区，必要时开始录制，可用于在拷贝之间录制屏障
+        VkCommandBuffer CommandBuffer();
+        //将数据经暂存区拷贝到缓冲区，超过ChunkSize()时分块提交，失败时返回false
+        bool CopyBuffer(VkBuffer buffer_dst, const void* pData_src, VkDeviceSize size, VkDeviceSize offset_dst = 0);
+        //将elementCount个间隔为stride_src的元素紧密地写入暂存区，再拷贝到缓冲区中间隔为stride_dst的位置
+        bool CopyBuffer(VkBuffer buffer_dst, const void* pData_src,
+                        uint32_t elementCount, VkDeviceSize elementSize, VkDeviceSize stride_src, VkDeviceSize stride_dst, VkDeviceSize offset_dst = 0);
+        //将紧密排列的数据经暂存区拷贝到图像，region.bufferOffset、bufferRowLength、bufferImageHeight会被忽略
+        //超过ChunkSize()时按行（3D图像按深度切片）分块提交，imb_from只用于第一块，imb_to只用于最后一块
+        //texel大小取自format，不支持压缩格式；size须等于texel大小乘以region中的texel数，否则报错并返回false
+        bool CopyBufferToImage(VkImage image_dst, VkFormat format, const void* pData_src, VkDeviceSize size, VkBufferImageCopy region,
+                               imageOperation::imageMemoryBarrierParameterPack imb_from,
+                               imageOperation::imageMemoryBarrierParameterPack imb_to);
+        //结束录制并提交，没有录制任何命令时返回已完成的ticket
+        ticket Submit();
+    };
+
+/*回读环：将GPU的计算结果异步拷贝回CPU，不阻塞提交
+    - 若干个槽，每个槽有一个从HOST_CACHED内存（若有）分配的持久映射缓冲区、一个命令缓冲区和一个栅栏
+    - CopyImage(...)/CopyBuffer(...)将拷贝命令提交到图形队列，按提交顺序在之前提交的命令之后执行
+    - Poll()按提交顺序检查栅栏，已完成的槽通过callback交付数据后被回收；结果通常晚一至两帧到达
+    - 所有槽都在使用中时CopyImage(...)/CopyBuffer(...)返回false，不等待
+
+    |--槽0(已交付)--|--槽1(GPU拷贝中)--|--槽2(GPU拷贝中)--|
+          ^next                ^oldest
+ */
+    class readbackRing {
+    public:
+        using callback_t = std::function<void(const void* pData, VkDeviceSize size)>;
+    private:
+        struct slot {
+            bufferMemory buffer_memory;
+            fence fence_copied;
+            VkCommandBuffer commandBuffer = (VkCommandBuffer)VK_NULL_HANDLE;
+            VkDeviceSize size = 0;
+            callback_t callback;
+            bool isPending = false;
+        };
+        commandPool command_pool;
+        std::vector<std::unique_ptr<slot>> slots;
+        VkDeviceSize sizePerSlot = 0;
+        uint32_t next = 0;  //下一个使用的槽
+        uint32_t oldest = 0;//最早提交、尚未交付的槽
+        //--------------------
+        //取得下一个空闲的槽并开始录制，没有空闲的槽时返回nullptr
+        slot* BeginSlot(VkDeviceSize size);
+        //结束录制并提交
+        void SubmitSlot(slot& slot_current, VkDeviceSize size, callback_t&& callback);
+        //交付最早提交的槽，wait为true时等待其完成
+        bool Deliver(bool wait);
+    public:
+        readbackRing() = default;
+        readbackRing(VkDeviceSize sizePerSlot, uint32_t slotCount = 3);
+        readbackRing(readbackRing&&) = delete;
+        ~readbackRing();
+        //Getter
+        VkDeviceSize SizePerSlot() const { return sizePerSlot; }
+        uint32_t SlotCount() const { return uint32_t(slots.size()); }
+        //Non-const Function
+        void Create(VkDeviceSize sizePerSlot, uint32_t slotCount = 3);
+        //将图像拷贝回CPU，region.bufferOffset、bufferRowLength、bufferImageHeight会被忽略，size为数据的字节数
+        bool CopyImage(VkImage image, VkDeviceSize size, VkBufferImageCopy region,
+                       imageOperation::imageMemoryBarrierParameterPack imb_from,
+                       imageOperation::imageMemoryBarrierParameterPack imb_to,
+                       callback_t callback);
+        //将缓冲区中[offset, offset + size)的数据拷贝回CPU，拷贝前等待之前所有命令对缓冲区的写入
+        bool CopyBuffer(VkBuffer buffer, VkDeviceSize size, VkDeviceSize offset, callback_t callback);
+        //交付已完成的回读，返回交付的个数
+        uint32_t Poll();
+        //等待并交付所有回读
+        void WaitAll();
+    };
+
+/*GPU分散写入：将稀疏的更新打包为(offset, payload)记录，一次写入，由计算着色器(shader/ScatterUpdate.comp)写入目标缓冲区
+    - 开销与改动的数据量成正比，而非VkBufferCopy的区域数；适用于每帧更新大型实例/粒子缓冲区中零散的元素
+    - 记录以4字节为单位：前recordCount个uint为目标偏移，其后为紧密排列的payload，一次CmdScatter(...)中所有记录的payload大小相同
+    - 记录写入每帧一段的持久映射storage缓冲区（同uniformRingBuffer），以动态偏移绑定当前帧的段，段中的位置经push constant传给着色器，
+      NextFrame()前须确保使用该段的那一帧已执行完毕
+    - 目标缓冲区须有VK_BUFFER_USAGE_STORAGE_BUFFER_BIT（如storageBuffer），每个目标缓冲区在首次使用时分配一个描述符集
+    - 描述符的范围不超过maxStorageBufferRange：每帧的段大小被限制在其以内，目标缓冲区中超出该范围的记录无法写入，CmdScatter(...)会报错并返回false
+    - 一批记录由多个调用并行写入，没有先后顺序：目标偏移相同的记录在Add(...)时合并，后添加的覆盖先添加的；
+      偏移不同但范围部分重叠的记录不允许，Debug下CmdScatter(...)会报错并返回false
+
+    Add(64, a) Add(4096, b) Add(256, c) -> |64|4096|256|a...|b...|c...| -> CmdScatter(...) -> dst[64] = a, dst[4096] = b, dst[256] = c
+ */
+    class bufferScatter {
+        descriptorSetLayout descriptorSetLayout_scatter;
+        pipelineLayout pipelineLayout_scatter;
+        pipeline pipeline_scatter;
+        std::unique_ptr<descriptorPool> descriptor_pool;
+        std::vector<std::pair<VkBuffer, descriptorSet>> descriptorSets; //按目标缓冲区缓存的描述符集
+        uint32_t maxDestinationCount = 0;
+        bufferMemory buffer_memory;
+        VkDeviceSize sizePerFrame = 0;
+        uint32_t frameCount = 0;
+        uint32_t currentFrame = 0;
+        VkDeviceSize head = 0; //当前帧中下一次分配的起始位置，相对于缓冲区起始
+        uint32_t wordCountPerRecord = 0;
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> payloads;
+        std::unordered_map<uint32_t, uint32_t> recordIndices; //目标偏移（以4字节为单位）到记录序号
+        //--------------------
+        void CreatePipeline();
+        //返回目标缓冲区对应的描述符集，必要时分配并写入，描述符集用完时返回VK_NULL_HANDLE
+        VkDescriptorSet DescriptorSet(VkBuffer buffer_dst, VkDeviceSize range_dst);
+    public:
+        static constexpr uint32_t localSizeX = 64;
+        bufferScatter() = default;
+        //sizePerFrame为每帧中所有记录（偏移加payload）的最大字节数
+        bufferScatter(VkDeviceSize sizePerFrame, uint32_t frameCount = 2, uint32_t maxDestinationCount = 8);
+        bufferScatter(bufferScatter&&) = delete;
+        //Getter
+        uint32_t RecordCount() const { return uint32_t(offsets.size()); }
+        uint32_t FrameCount() const { return frameCount; }
+        uint32_t CurrentFrame() const { return currentFrame; }
+        //Non-const Function
+        void Create(VkDeviceSize sizePerFrame, uint32_t frameCount = 2, uint32_t maxDestinationCount = 8);
+        //切换到下一帧的那一段，并将该段清空
+        void NextFrame();
+        //添加一条记录，offset_dst与size须为4的倍数，且size须与本批次中之前的记录相同，否则返回false
+        //offset_dst与本批次中之前的记录相同时覆盖那条记录的payload
+        bool Add(VkDeviceSize offset_dst, const void* pData_src, VkDeviceSize size);
+        template<typename T>
+        bool Add(VkDeviceSize offset_dst, const T& data_src) {
+            return Add(offset_dst, &data_src, sizeof(T));
+        }
+        //丢弃尚未录制的记录
+        void Clear();
+        //目标缓冲区被销毁后须调用，以免其句柄被新的缓冲区复用时沿用旧的描述符集
+        void ForgetDestinations();
+        //将已添加的记录写入当前帧的段，并录制写入buffer_dst的命令，之后清空记录
+        //size_dst为目标缓冲区的大小，用于确定其描述符的范围
+        //stage_from/access_from为之前对目标缓冲区的访问，stage_to/access_to为之后的访问
+        bool CmdScatter(VkCommandBuffer commandBuffer, VkBuffer buffer_dst, VkDeviceSize size_dst,
+                        VkPipelineStageFlags stage_from, VkAccessFlags access_from,
+                        VkPipelineStageFlags stage_to, VkAccessFlags access_to);
+    };
+
+/*批量提交：收集各子系统（上传、计算、渲染）在一帧中的提交，Flush(...)时依次提交，通常每个队列只调用一次vkQueueSubmit(...)，以减少驱动的固定开销
+    - 每次Add(...)对应一个VkSubmitInfo；若其没有等待的信号量，且上一个VkSubmitInfo没有要置位的信号量，则并入上一个
+    - VkSubmitInfo中的指针在Flush(...)时才填写，Add(...)的参数在其返回后即可销毁
+    - 提交按VkQueue而非用途分段（如没有专用的传输队列时，传输即提交到图形队列），段按添加顺序排列，Flush(...)时每段一次vkQueueSubmit(...)
+    - Add(...)并入其VkQueue的最后一段，除非之后的段（其他队列）置位了它等待的信号量，此时在末尾新开一段：
+      二值信号量的等待须在其置位之后提交，这样等待它的提交总是位于置位它的提交之后，代价是多一次vkQueueSubmit(...)
+    - 因此须先添加置位信号量的提交，再添加等待它的提交（即按上传→计算→渲染的依赖顺序添加）
+    - Add(...)和Flush(...)可在多个线程中调用
+
+    无专用传输队列时（传输与图形为同一VkQueue）：
+    Add(transfer, 上传, signal: A)  Add(compute, 粒子, wait: A, signal: B)  Add(graphics, 渲染, wait: B)
+    段:     [图形: 上传]                 [计算: 粒子]                           [图形: 渲染]（B由之前的段置位，不能并入第一段）
+    Flush(): vkQueueSubmit(图形队列, 1) → vkQueueSubmit(计算队列, 1) → vkQueueSubmit(图形队列, 1, fence)
+ */
+    class submitBatch {
+    public:
+        enum queueType :uint32_t {
+            transfer,
+            compute,
+            graphics,
+            queueTypeCount
+        };
+    private:
+        struct submission {
+            uint32_t commandBufferCount;
+            uint32_t waitSemaphoreCount;
+            uint32_t signalSemaphoreCount;
+        };
+        //提交到同一VkQueue的连续的一段，Flush(...)时一次vkQueueSubmit(...)
+        struct segment {
+            VkQueue queue;
+            std::vector<submission> submissions;
+            std::vector<VkCommandBuffer> commandBuffers;
+            std::vector<VkSemaphore> waitSemaphores;
+            std::vector<VkPipelineStageFlags> waitDstStages;
+            std::vector<VkSemaphore> signalSemaphores;
+        };
+        //只增不减，前segmentCount个在用，以免每帧重新分配
+        std::vector<std::unique_ptr<segment>> segments;
+        uint32_t segmentCount = 0;
+        std::vector<VkSubmitInfo> submitInfos; //Flush(...)时填写
+        mutable std::mutex mtx;
+        //--------------------
+        static VkQueue Queue(queueType queue);
+        //Add(...)应并入的段：queue的最后一段，且之后的段不置位waitSemaphores中的任何一个，否则在末尾新开一段
+        segment& Segment(VkQueue queue, arrayRef<const VkSemaphore> waitSemaphores);
+        void ClearSegments();
+    public:
+        submitBatch() = default;
+        submitBatch(submitBatch&&) = delete;
+        //Const Function
+        //将要提交到queue（所在VkQueue）的VkSubmitInfo的个数
+        uint32_t SubmitInfoCount(queueType queue) const;
+        bool Empty() const;
+        //Non-const Function
+        //添加一次提交，waitDstStages与waitSemaphores一一对应；参数有误时报错并返回false
+        bool Add(queueType queue, arrayRef<const VkCommandBuffer> commandBuffers,
+                 arrayRef<const VkSemaphore> waitSemaphores = {}, arrayRef<const VkPipelineStageFlags> waitDstStages = {},
+                 arrayRef<const VkSemaphore> signalSemaphores = {});
+        //按顺序提交所有段，fence随queue所在VkQueue的最后一次提交置位（该队列无提交或该次提交失败时以空提交置位栅栏），返回第一个错误
+        result_t Flush(queueType queue, VkFence fence);
+        //同上，fence_graphics为图形队列的栅栏
+        result_t Flush(VkFence fence_graphics = (VkFence)VK_NULL_HANDLE) { return Flush(graphics, fence_graphics); }
+        //丢弃尚未提交的记录
+        void Clear();
+    };
+
+/*帧上下文：同时处理frameCount帧（frames in flight），录制下一帧时GPU仍在执行之前的帧
+    - 每帧有各自的命令池、主命令缓冲区、栅栏（以置位状态创建），以及获取交换链图像的信号量
+    - 渲染结束的信号量按交换链图像索引，而非按帧：呈现等待它，而该图像被再次获取前呈现可能尚未完成，按帧复用会在其仍被等待时再次置位
+    - BeginFrame()等待该帧上一次提交的栅栏，即frameCount帧之前的提交，先获取交换链图像，成功后才以vkResetCommandPool(...)整体重置该帧的命令池，
+      并推进deferredDestructionQueue和该帧的临时分配器（uniformRingBuffer的那一段）；获取失败时什么都不推进，重试BeginFrame()是安全的
+    - 临时分配器中的内容只在该帧内有效：AllocateCommandBuffer(...)取得的命令缓冲区在命令池重置时回收，之后重复使用
+    - EndFrame()提交主命令缓冲区并呈现，然后切换到下一帧；栅栏在提交前才重置，获取图像失败时不会永久等待，提交失败时栅栏由空提交置位，同样不会
+    - 创建时将deferredDestructionQueue的帧数设为frameCount
+    - 其他子系统可将本帧的提交加入Submissions()，EndFrame()将主命令缓冲区加入其中后一并提交，栅栏随图形队列的提交置位
+    - 本帧写入的非host coherent的持久映射内存可记录到MappedRanges()，EndFrame()提交前与临时uniform缓冲区一并以一次vkFlushMappedMemoryRanges(...)刷新
+
+    CPU: |录制0|录制1|等待栅栏0|录制2|等待栅栏1|录制3|
+    GPU:       |执行0      |执行1      |执行2      |
+ */
+    class frameContext {
+        struct frame {
+            commandPool command_pool;
+            commandBuffer command_buffer;
+            fence fence_inFlight = fence(VK_FENCE_CREATE_SIGNALED_BIT);
+            semaphore semaphore_imageIsAvailable;
+            //AllocateCommandBuffer(...)分配的命令缓冲区，按级别存放，usedCounts为本帧已取用的个数
+            std::vector<VkCommandBuffer> commandBuffers[2];
+            uint32_t usedCounts[2] = {};
+        };
+        std::vector<std::unique_ptr<frame>> frames;
+        uint32_t currentFrame = 0;
+        //每张交换链图像一个，BeginFrame()时按交换链图像数增减
+        std::vector<semaphore> semaphores_renderingIsOver;
+        uniformRingBuffer transientUniforms;
+        submitBatch submissions;
+        mappedMemoryRangeBatch mappedRanges;
+    public:
+        frameContext() = default;
+        frameContext(uint32_t frameCount, VkDeviceSize transientUniformSizePerFrame = 0);
+        frameContext(frameContext&&) = delete;
+        //Getter
+        uint32_t FrameCount() const { return uint32_t(frames.size()); }
+        uint32_t CurrentFrame() const { return currentFrame; }
+        const commandBuffer& CommandBuffer() const { return frames[currentFrame]->command_buffer; }
+        const commandPool& CommandPool() const { return frames[currentFrame]->command_pool; }
+        VkFence Fence() const { return frames[currentFrame]->fence_inFlight; }
+        VkSemaphore Semaphore_ImageIsAvailable() const { return frames[currentFrame]->semaphore_imageIsAvailable; }
+        //当前交换链图像的渲染结束信号量，BeginFrame()成功后才有效
+        VkSemaphore Semaphore_RenderingIsOver() const { return semaphores_renderingIsOver[graphicsBase::Base().CurrentImageIndex()]; }
+        //每帧一段的临时uniform缓冲区，BeginFrame()时切换到当前帧的那一段，transientUniformSizePerFrame为0时未创建
+        uniformRingBuffer& TransientUniforms() { return transientUniforms; }
+        //本帧的批量提交，EndFrame()时与主命令缓冲区一并提交
+        submitBatch& Submissions() { return submissions; }
+        //本帧待刷新的内存区，EndFrame()提交前一并刷新
+        mappedMemoryRangeBatch& MappedRanges() { return mappedRanges; }
+        //Non-const Function
+        void Create(uint32_t frameCount, VkDeviceSize transientUniformSizePerFrame = 0);
+        //等待当前帧的栅栏，获取交换链图像（之后可用CurrentImageIndex()），成功后重置命令池和临时分配器，返回获取图像的结果
+        result_t BeginFrame();
+        //从当前帧的命令池分配一个命令缓冲区，命令池重置后被回收，下一次轮到该帧时重复使用
+        VkCommandBuffer AllocateCommandBuffer(VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+        //提交Submissions()和CommandBuffer()（须已结束录制），等待图像可用的阶段为waitDstStage，然后呈现图像并切换到下一帧
+        result_t EndFrame(VkPipelineStageFlags waitDstStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        //同上，但提交的是commandBuffer（如recordedCommandBuffers中预录制的命令缓冲区）而非CommandBuffer()
+        result_t EndFrame(VkCommandBuffer commandBuffer, VkPipelineStageFlags waitDstStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        //等待所有帧执行完毕
+        void WaitAll() const;
+    };
+
+/*并行录制：将渲染通道内的绘制分给多个工作线程，各自录制到次级命令缓冲区，再由主命令缓冲区以vkCmdExecuteCommands(...)执行
+    - 命令池不是线程安全的：每个工作线程在每一帧有自己的命令池，次级命令缓冲区从中分配，BeginFrame(...)时随命令池整体重置后重复使用
+    - CmdExecuteParallel(...)将[0, itemCount)均分为至多WorkerCount()段，每段由一个工作线程录制到一个次级命令缓冲区
+      （以RENDER_PASS_CONTINUE_BIT开始，继承渲染通道、子通道和帧缓冲），全部录制完毕后在主命令缓冲区中执行（join）
+    - 主命令缓冲区须以VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS开始该子通道，该子通道中不能再直接录制绘制命令
+    - 次级命令缓冲区不继承主命令缓冲区中绑定的管线、描述符集和顶点缓冲区，每段须自行绑定；record须能被多个线程同时调用
+
+    主线程:   |BeginFrame|CmdBegin(SECONDARY)|   等待   |vkCmdExecuteCommands|CmdEnd|
+    工作线程0:                               |录制[0, n)|
+    工作线程1:                               |录制[n, 2n)|
+ */
+    class parallelRecorder {
+    public:
+        //在commandBuffer中录制[begin, end)的绘制，workerIndex为工作线程的序号，可用来索引各线程自己的临时数据
+        using record_t = std::function<void(VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end, uint32_t workerIndex)>;
+    private:
+        struct worker {
+            std::thread thread;
+            std::vector<commandPool> pools;                     //每帧一个
+            std::vector<std::vector<VkCommandBuffer>> buffers;  //每帧已分配的次级命令缓冲区
+            uint32_t usedCount = 0;                             //当前帧已取用的个数
+        };
+        std::vector<std::unique_ptr<worker>> workers;
+        uint32_t currentFrame = 0;
+        //分派给工作线程的任务
+        std::mutex mtx;
+        std::condition_variable condition_job;
+        std::condition_variable condition_done;
+        std::function<void(uint32_t workerIndex)> job;
+        uint64_t jobIndex = 0;     //每分派一次任务加1，工作线程据此判断是否有新任务
+        uint32_t pendingCount = 0; //尚未完成当前任务的工作线程数
+        bool exiting = false;
+        //--------------------
+        void WorkerLoop(uint32_t workerIndex);
+        //在所有工作线程上执行job并等待完成
+        void RunOnWorkers(std::function<void(uint32_t workerIndex)> job);
+        //从工作线程workerIndex当前帧的命令池取得一个次级命令缓冲区，只在该工作线程上调用
+        VkCommandBuffer SecondaryCommandBuffer(uint32_t workerIndex);
+        void Destroy();
+    public:
+        parallelRecorder() = default;
+        parallelRecorder(uint32_t workerCount, uint32_t frameCount = 2);
+        parallelRecorder(parallelRecorder&&) = delete;
+        ~parallelRecorder() { Destroy(); }
+        //Getter
+        uint32_t WorkerCount() const { return uint32_t(workers.size()); }
+        //Non-const Function
+        //workerCount为0时取硬件线程数；frameCount须与frameContext的帧数相同
+        void Create(uint32_t workerCount, uint32_t frameCount = 2);
+        //切换到frameIndex帧（即frameContext::CurrentFrame()）并重置各工作线程在该帧的命令池，须在frameContext::BeginFrame()之后调用
+        result_t BeginFrame(uint32_t frameIndex);
+        //在当前子通道中并行录制itemCount个绘制并执行，commandBuffer_primary须以VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS开始渲染通道
+        //minItemCountPerWorker用于避免绘制很少时仍分给每个线程，返回执行的次级命令缓冲区的个数
+        uint32_t CmdExecuteParallel(VkCommandBuffer commandBuffer_primary, VkRenderPass renderPass, uint32_t subpass, VkFramebuffer framebuffer,
+                                    uint32_t itemCount, const record_t& record, uint32_t minItemCountPerWorker = 64);
+    };
+
+/*预录制的命令缓冲区：静态场景每帧的命令都相同，为每张交换链图像（即RenderPassAndFramebuffers().framebuffers[i]）录制一次，之后每帧直接提交
+    - CommandBuffer(imageIndex)在该图像的命令缓冲区尚未录制或已失效时调用record录制，否则直接返回，CPU几乎没有录制开销
+    - 录制所依赖的东西（管线、缓冲区、描述符集、dynamic offset等）改变时须调用Invalidate()；交换链重建时（帧缓冲和窗口大小随之改变）自动全部失效
+    - 失效的命令缓冲区可能仍在执行，不重置，而是随命令池整体移入deferredDestructionQueue，重新录制时从新的命令池分配
+    - 以SIMULTANEOUS_USE_BIT录制，上一次提交尚未执行完时也可以再次提交
+    - 录制的命令中不能含有每帧变化的数据：每帧更新的uniform须位于固定的位置，不能用uniformRingBuffer（其dynamic offset每帧不同）
+
+    帧:   |   0    |   1    |   2    |   3    |...
+    CPU:  |录制img0|录制img1|提交img0|提交img1|...
+ */
+    class recordedCommandBuffers {
+    public:
+        //在commandBuffer中录制交换链图像imageIndex的命令，commandBuffer已开始录制，不必调用Begin/End
+        using record_t = std::function<void(VkCommandBuffer commandBuffer, uint32_t imageIndex)>;
+    private:
+        commandPool command_pool;
+        std::vector<VkCommandBuffer> commandBuffers; //每张交换链图像一个，尚未录制或已失效的为VK_NULL_HANDLE
+        record_t record;
+        uint64_t swapchainGeneration = 0;
+        uint32_t recordCount = 0;
+        //--------------------
+        //交换链每重建一次加1，首次调用时注册回调
+        static uint64_t SwapchainGeneration();
+    public:
+        recordedCommandBuffers() = default;
+        recordedCommandBuffers(record_t record);
+        recordedCommandBuffers(recordedCommandBuffers&&) = delete;
+        //Getter
+        //累计的录制次数，用于确认命令缓冲区是否被重复使用
+        uint32_t RecordCount() const { return recordCount; }
+        //Non-const Function
+        void Create(record_t record);
+        //使所有命令缓冲区失效，下一次CommandBuffer(...)时重新录制
+        void Invalidate();
+        //取得交换链图像imageIndex对应的命令缓冲区，必要时先录制，录制失败时返回VK_NULL_HANDLE
+        VkCommandBuffer CommandBuffer(uint32_t imageIndex);
+    };
 }
 
 extern formatInfo FormatInfo(VkFormat format);
+extern formatInfo::numeric FormatNumeric(VkFormat format);
 extern VkFormat Corresponding16BitFloatFormat(VkFormat format_32BitFloat);
 extern const VkFormatProperties& FormatProperties(VkFormat format);
 
@@ -325,6 +325,20 @@ VkResult graphicsBase::GetQueueFamilyIndices(VkPhysicalDevice physicalDevice, bo
     return VK_SUCCESS;
 }
 
+uint32_t graphicsBase::GetQueueFamilyIndex_Transfer(VkPhysicalDevice physicalDevice) const
+{
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilyPropertieses(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilyPropertieses.data());
+    //支持图形或计算的队列族也一定支持数据传输，只要不支持这两者而支持传输的队列族
+    for (uint32_t i = 0; i < queueFamilyCount; i++)
+        if (queueFamilyPropertieses[i].queueFlags & VK_QUEUE_TRANSFER_BIT &&
+            !(queueFamilyPropertieses[i].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+            return i;
+    return VK_QUEUE_FAMILY_IGNORED;
+}
+
 VkPhysicalDevice graphicsBase::PhysicalDevice() const
 {
     return physicalDevice;
@@ -371,6 +385,11 @@ uint32_t graphicsBase::QueueFamilyIndex_Compute() const
     return queueFamilyIndex_compute;
 }
 
+uint32_t graphicsBase::QueueFamilyIndex_Transfer() const
+{
+    return queueFamilyIndex_transfer;
+}
+
 VkQueue graphicsBase::Queue_Graphics() const
 {
     return queue_graphics;
@@ -386,6 +405,21 @@ VkQueue graphicsBase::Queue_Compute() const
     return queue_compute;
 }
 
+VkQueue graphicsBase::Queue_Transfer() const
+{
+    return queue_transfer;
+}
+
+bool graphicsBase::HasDedicatedTransferQueue() const
+{
+    return queueFamilyIndex_transfer != queueFamilyIndex_graphics;
+}
+
+bool graphicsBase::BufferDeviceAddressEnabled() const
+{
+    return bufferDeviceAddressEnabled;
+}
+
 const std::vector<const char *> &graphicsBase::DeviceExtensions() const
 {
     return deviceExtensions;
@@ -482,7 +516,8 @@ VkResult graphicsBase::DeterminePhysicalDevice(uint32_t deviceIndex, bool enable
 VkResult graphicsBase::CreateDevice(VkDeviceCreateFlags flags)
 {
     float queuePriority = 1.0f;
-    VkDeviceQueueCreateInfo queueCreateInfos[3] = {
+    VkDeviceQueueCreateInfo queueCreateInfos[4] = {
+        { VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO, nullptr, 0,0,1, &queuePriority},
         { VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO, nullptr, 0,0,1, &queuePriority},
         { VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO, nullptr, 0,0,1, &queuePriority},
         { VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO, nullptr, 0,0,1, &queuePriority}
@@ -498,12 +533,55 @@ VkResult graphicsBase::CreateDevice(VkDeviceCreateFlags flags)
         queueFamilyIndex_compute != queueFamilyIndex_graphics &&
         queueFamilyIndex_compute != queueFamilyIndex_presentation)
         queueCreateInfos[queueCreateInfoCount++].queueFamilyIndex = queueFamilyIndex_compute;
+    //专用的传输队列族不支持图形和计算，不可能与以上队列族相同
+    queueFamilyIndex_transfer = VK_QUEUE_FAMILY_IGNORED;
+    if (queueFamilyIndex_graphics != VK_QUEUE_FAMILY_IGNORED)
+        queueFamilyIndex_transfer = GetQueueFamilyIndex_Transfer(physicalDevice);
+    if (queueFamilyIndex_transfer != VK_QUEUE_FAMILY_IGNORED)
+        queueCreateInfos[queueCreateInfoCount++].queueFamilyIndex = queueFamilyIndex_transfer;
 
     VkPhysicalDeviceFeatures physicalDeviceFeatures;
     vkGetPhysicalDeviceFeatures(physicalDevice, &physicalDeviceFeatures);
 
+    //若支持VK_EXT_memory_budget则启用，用于内存统计（查询时需要Vulkan1.1的vkGetPhysicalDeviceMemoryProperties2(...)）
+    memoryBudgetEnabled = false;
+    if (apiVersion >= VK_API_VERSION_1_1) {
+        uint32_t extensionCount = 0;
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+        for (auto& i : availableExtensions)
+            if (!strcmp(i.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+                AddDeviceExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+                memoryBudgetEnabled = true;
+                break;
+            }
+    }
+
+    //若支持bufferDeviceAddress则启用，缓冲区是否使用由创建时的VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT决定
+    VkPhysicalDeviceBufferDeviceAddressFeatures bufferDeviceAddressFeatures = {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES
+    };
+    bufferDeviceAddressEnabled = false;
+    if (apiVersion >= VK_API_VERSION_1_2) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        if (properties.apiVersion >= VK_API_VERSION_1_2) {
+            VkPhysicalDeviceFeatures2 physicalDeviceFeatures2 = {
+                VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+                &bufferDeviceAddressFeatures
+            };
+            vkGetPhysicalDeviceFeatures2(physicalDevice, &physicalDeviceFeatures2);
+            bufferDeviceAddressEnabled = bufferDeviceAddressFeatures.bufferDeviceAddress;
+            //只启用bufferDeviceAddress，不需要的可选特性保持关闭
+            bufferDeviceAddressFeatures.bufferDeviceAddressCaptureReplay = VK_FALSE;
+            bufferDeviceAddressFeatures.bufferDeviceAddressMultiDevice = VK_FALSE;
+        }
+    }
+
     VkDeviceCreateInfo deviceCreateInfo = {};
     deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    deviceCreateInfo.pNext = bufferDeviceAddressEnabled ? &bufferDeviceAddressFeatures : nullptr;
     deviceCreateInfo.flags = flags;
     deviceCreateInfo.queueCreateInfoCount = queueCreateInfoCount;
     deviceCreateInfo.pQueueCreateInfos =  queueCreateInfos;
@@ -524,7 +602,15 @@ VkResult graphicsBase::CreateDevice(VkDeviceCreateFlags flags)
         vkGetDeviceQueue(device,queueFamilyIndex_presentation,0,&queue_presentation);
     }
     if(queueFamilyIndex_compute != VK_QUEUE_FAMILY_IGNORED){
-        vkGetDeviceQueue(device,queueFamilyIndex_presentation,0,&queue_compute);
+        vkGetDeviceQueue(device,queueFamilyIndex_compute,0,&queue_compute);
+    }
+    //没有专用的传输队列族时，传输队列即图形队列
+    if(queueFamilyIndex_transfer != VK_QUEUE_FAMILY_IGNORED){
+        vkGetDeviceQueue(device,queueFamilyIndex_transfer,0,&queue_transfer);
+    }
+    else{
+        queueFamilyIndex_transfer = queueFamilyIndex_graphics;
+        queue_transfer = queue_graphics;
     }
     //逻辑设备成功创建后，物理设备不会再变更。获取以下物理设备属性
     vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
@@ -816,8 +902,13 @@ VkResult graphicsBase::RecreateSwapchain()
 
 
     //重建交换链最好等待图形和呈现队列空闲（交换链图像被图形队列写入，被呈现队列读取）
-    VkResult result = vkQueueWaitIdle(queue_graphics); //仅在等待图形队列成功，且图形与呈现所用队列不同时等待呈现队列
+    VkResult result;
+    {
+        std::lock_guard<std::mutex> lock(QueueMutex(queue_graphics));
+        result = vkQueueWaitIdle(queue_graphics); //仅在等待图形队列成功，且图形与呈现所用队列不同时等待呈现队列
+    }
     if (!result &&queue_graphics != queue_presentation){
+        std::lock_guard<std::mutex> lock(QueueMutex(queue_presentation));
         result = vkQueueWaitIdle(queue_presentation);
     }
     if (result) {
@@ -884,13 +975,40 @@ void graphicsBase::AddCallback_DestroyDevice(std::function<void()> function)
 
 VkResult graphicsBase::WaitIdle() const
 {
-    VkResult result = vkDeviceWaitIdle(device);
+    VkResult result;
+    {
+        std::lock(queue_mtxs[0], queue_mtxs[1], queue_mtxs[2], queue_mtxs[3]);
+        std::lock_guard<std::mutex> lock_graphics(queue_mtxs[0], std::adopt_lock);
+        std::lock_guard<std::mutex> lock_presentation(queue_mtxs[1], std::adopt_lock);
+        std::lock_guard<std::mutex> lock_compute(queue_mtxs[2], std::adopt_lock);
+        std::lock_guard<std::mutex> lock_transfer(queue_mtxs[3], std::adopt_lock);
+        result = vkDeviceWaitIdle(device);
+    }
     if (result){
         qDebug("[ graphicsBase ] ERROR\nFailed to wait for the device to be idle!\nError code: %d\n", int32_t(result));
     }
+    //设备空闲时GPU不再使用延迟销毁队列中的任何对象，即使从未调用过NextFrame()，也在此全部销毁
+    else
+        deferredDestructionQueue::Get().DestroyAll();
     return result;
 }
 
+std::mutex& graphicsBase::QueueMutex(VkQueue queue) const
+{
+    //取第一个句柄相同的队列，使同一VkQueue的不同用途共用一个锁
+    const VkQueue queues[] = { queue_graphics, queue_presentation, queue_compute, queue_transfer };
+    for (size_t i = 0; i < 4; i++)
+        if (queues[i] == queue)
+            return queue_mtxs[i];
+    //不是从graphicsBase取得的队列，与图形队列共用一个锁（只多了不必要的等待，不会漏锁）
+    return queue_mtxs[0];
+}
+
+std::unique_lock<std::mutex> graphicsBase::LockQueue(VkQueue queue) const
+{
+    return std::unique_lock<std::mutex>(QueueMutex(queue));
+}
+
 VkResult graphicsBase::RecreateDevice(VkDeviceCreateFlags flags)
 {
     //销毁原有的逻辑设备
@@ -965,16 +1083,23 @@ result_t graphicsBase::SwapImage(VkSemaphore semaphore_imageIsAvailable)
     return VK_SUCCESS;
 }
 
-result_t graphicsBase::SubmitCommandBuffer_Graphics(VkSubmitInfo &submitInfo, VkFence fence) const
+result_t graphicsBase::SubmitCommandBuffers(VkQueue queue, arrayRef<VkSubmitInfo> submitInfos, VkFence fence) const
 {
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    VkResult result = vkQueueSubmit(queue_graphics, 1, &submitInfo, fence);
+    for (auto& i : submitInfos)
+        i.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    std::lock_guard<std::mutex> lock(QueueMutex(queue));
+    VkResult result = vkQueueSubmit(queue, uint32_t(submitInfos.Count()), submitInfos.Pointer(), fence);
     if (result){
         qDebug("[ graphicsBase ] ERROR\nFailed to submit the command buffer!\nError code: %d\n", int32_t(result));
     }
     return result;
 }
 
+result_t graphicsBase::SubmitCommandBuffer_Graphics(VkSubmitInfo &submitInfo, VkFence fence) const
+{
+    return SubmitCommandBuffers(queue_graphics, submitInfo, fence);
+}
+
 result_t graphicsBase::SubmitCommandBuffer_Graphics(VkCommandBuffer commandBuffer, VkSemaphore semaphore_imageIsAvailable, VkSemaphore semaphore_renderingIsOver, VkFence fence, VkPipelineStageFlags waitDstStage_imageIsAvailable) const
 {
     VkSubmitInfo submitInfo = {};
@@ -1003,12 +1128,7 @@ result_t graphicsBase::SubmitCommandBuffer_Graphics(VkCommandBuffer commandBuffe
 
 result_t graphicsBase::SubmitCommandBuffer_Compute(VkSubmitInfo &submitInfo, VkFence fence) const
 {
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    VkResult result = vkQueueSubmit(queue_compute, 1, &submitInfo, fence);
-    if (result){
-        qDebug("[ graphicsBase ] ERROR\nFailed to submit the command buffer!\nError code: %d\n", int32_t(result));
-    }
-    return result;
+    return SubmitCommandBuffers(queue_compute, submitInfo, fence);
 }
 
 result_t graphicsBase::SubmitCommandBuffer_Compute(VkCommandBuffer commandBuffer, VkFence fence) const
@@ -1019,10 +1139,33 @@ result_t graphicsBase::SubmitCommandBuffer_Compute(VkCommandBuffer commandBuffer
     return SubmitCommandBuffer_Compute(submitInfo, fence);
 }
 
+result_t graphicsBase::SubmitCommandBuffer_Transfer(VkSubmitInfo &submitInfo, VkFence fence) const
+{
+    return SubmitCommandBuffers(queue_transfer, submitInfo, fence);
+}
+
+result_t graphicsBase::SubmitCommandBuffer_Transfer(VkCommandBuffer commandBuffer, VkSemaphore semaphore_transferIsOver, VkFence fence) const
+{
+    VkSubmitInfo submitInfo = {};
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    if (semaphore_transferIsOver){
+        submitInfo.signalSemaphoreCount = 1,
+        submitInfo.pSignalSemaphores = &semaphore_transferIsOver;
+    }
+    return SubmitCommandBuffer_Transfer(submitInfo, fence);
+}
+
 result_t graphicsBase::PresentImage(VkPresentInfoKHR &presentInfo)
 {
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    switch (VkResult result = vkQueuePresentKHR(queue_presentation, &presentInfo)) {
+    VkResult result;
+    {
+        //重建交换链时要等待队列空闲，须先解锁
+        std::lock_guard<std::mutex> lock(QueueMutex(queue_presentation));
+        result = vkQueuePresentKHR(queue_presentation, &presentInfo);
+    }
+    switch (result) {
     case VK_SUCCESS:
         return VK_SUCCESS;
     case VK_SUBOPTIMAL_KHR:
@@ -1063,6 +1206,7 @@ result_t graphicsBase::SubmitCommandBuffer_Presentation(VkCommandBuffer commandB
         submitInfo.signalSemaphoreCount = 1,
         submitInfo.pSignalSemaphores = &semaphore_ownershipIsTransfered;
     }
+    std::lock_guard<std::mutex> lock(QueueMutex(queue_presentation));
     VkResult result = vkQueueSubmit(queue_presentation, 1, &submitInfo, fence);
     if (result){
         qDebug("[ graphicsBase ] ERROR\nFailed to submit the presentation command buffer!\nError code: %d\n", int32_t(result));
@@ -1085,3 +1229,421 @@ void graphicsBase::CmdTransferImageOwnership(VkCommandBuffer commandBuffer) cons
     vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
         0, nullptr, 0, nullptr, 1, &imageMemoryBarrier_g2p);
 }
+
+graphicsBase::memoryStatistics graphicsBase::MemoryStatistics() const
+{
+    memoryStatistics result;
+    {
+        std::lock_guard<std::mutex> lock(statistics_mtx);
+        result = statistics;
+    }
+    result.budgetAvailable = false;
+    if (memoryBudgetEnabled) {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT memoryBudgetProperties = {};
+        memoryBudgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        VkPhysicalDeviceMemoryProperties2 memoryProperties2 = {};
+        memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        memoryProperties2.pNext = &memoryBudgetProperties;
+        vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memoryProperties2);
+        for (uint32_t i = 0; i < physicalDeviceMemoryProperties.memoryHeapCount; i++)
+            result.budget_heap[i] = memoryBudgetProperties.heapBudget[i],
+            result.usage_heap[i] = memoryBudgetProperties.heapUsage[i];
+        result.budgetAvailable = true;
+    }
+    return result;
+}
+
+void graphicsBase::PrintMemoryStatistics() const
+{
+    static const char* objectTypeNames[memoryObject_count] = { "other", "bufferMemory", "imageMemory", "stagingBuffer" };
+    memoryStatistics statistics = MemoryStatistics();
+    qDebug("[ graphicsBase ] Memory statistics\nAllocations: %u (peak %u)\nAllocated: %llu bytes (peak %llu bytes)\n",
+           statistics.allocationCount, statistics.peakAllocationCount,
+           (unsigned long long)statistics.allocatedSize, (unsigned long long)statistics.peakAllocatedSize);
+    for (uint32_t i = 0; i < physicalDeviceMemoryProperties.memoryHeapCount; i++)
+        if (statistics.budgetAvailable)
+            qDebug("Heap %u: %llu bytes (peak %llu bytes), budget %llu bytes, usage %llu bytes\n", i,
+                   (unsigned long long)statistics.allocatedSize_heap[i], (unsigned long long)statistics.peakAllocatedSize_heap[i],
+                   (unsigned long long)statistics.budget_heap[i], (unsigned long long)statistics.usage_heap[i]);
+        else
+            qDebug("Heap %u: %llu bytes (peak %llu bytes)\n", i,
+                   (unsigned long long)statistics.allocatedSize_heap[i], (unsigned long long)statistics.peakAllocatedSize_heap[i]);
+    for (uint32_t i = 0; i < physicalDeviceMemoryProperties.memoryTypeCount; i++)
+        if (statistics.allocatedSize_memoryType[i])
+            qDebug("Memory type %u: %llu bytes\n", i, (unsigned long long)statistics.allocatedSize_memoryType[i]);
+    for (uint32_t i = 0; i < memoryObject_count; i++)
+        qDebug("%s: %u objects, %llu bytes\n", objectTypeNames[i], statistics.objectCount[i], (unsigned long long)statistics.objectSize[i]);
+}
+
+void graphicsBase::RecordMemoryAllocation(uint32_t memoryTypeIndex, VkDeviceSize size)
+{
+    uint32_t heapIndex = physicalDeviceMemoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+    std::lock_guard<std::mutex> lock(statistics_mtx);
+    statistics.allocationCount++;
+    statistics.allocatedSize += size;
+    statistics.allocatedSize_memoryType[memoryTypeIndex] += size;
+    statistics.allocatedSize_heap[heapIndex] += size;
+    statistics.peakAllocationCount = std::max(statistics.peakAllocationCount, statistics.allocationCount);
+    statistics.peakAllocatedSize = std::max(statistics.peakAllocatedSize, statistics.allocatedSize);
+    statistics.peakAllocatedSize_heap[heapIndex] = std::max(statistics.peakAllocatedSize_heap[heapIndex], statistics.allocatedSize_heap[heapIndex]);
+}
+
+void graphicsBase::RecordMemoryFree(uint32_t memoryTypeIndex, VkDeviceSize size)
+{
+    uint32_t heapIndex = physicalDeviceMemoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+    std::lock_guard<std::mutex> lock(statistics_mtx);
+    statistics.allocationCount--;
+    statistics.allocatedSize -= size;
+    statistics.allocatedSize_memoryType[memoryTypeIndex] -= size;
+    statistics.allocatedSize_heap[heapIndex] -= size;
+}
+
+void graphicsBase::RecordObjectAllocation(memoryObjectType type, VkDeviceSize size)
+{
+    std::lock_guard<std::mutex> lock(statistics_mtx);
+    statistics.objectCount[type]++;
+    statistics.objectSize[type] += size;
+}
+
+void graphicsBase::RecordObjectFree(memoryObjectType type, VkDeviceSize size)
+{
+    std::lock_guard<std::mutex> lock(statistics_mtx);
+    statistics.objectCount[type]--;
+    statistics.objectSize[type] -= size;
+}
+
+memoryTypeSelector::memoryTypeSelector()
+{
+    graphicsBase::Base().AddCallback_DestroyDevice([] { Get().ClearCache(); });
+}
+
+int32_t memoryTypeSelector::Score(VkMemoryPropertyFlags memoryProperties, intent memoryIntent)
+{
+    //受保护的内存和延迟分配的内存另有用途，不参与选择
+    if (memoryProperties & (VK_MEMORY_PROPERTY_PROTECTED_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT))
+        return -1;
+    bool isDeviceLocal = memoryProperties & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    bool isHostVisible = memoryProperties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    bool isHostCoherent = memoryProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    bool isHostCached = memoryProperties & VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    switch (memoryIntent) {
+    case gpuOnly:
+        return isDeviceLocal * 100 + !isHostVisible * 10;
+    case deviceLocal:
+        if (!isDeviceLocal)
+            return -1;
+        return isHostVisible * 100 + isHostCoherent * 10;
+    case upload:
+        if (!isHostVisible)
+            return -1;
+        return isHostCoherent * 100 + !isHostCached * 10 + !isDeviceLocal;
+    case readback:
+        if (!isHostVisible)
+            return -1;
+        return isHostCached * 100 + isHostCoherent * 10;
+    case dynamic:
+        if (!isHostVisible)
+            return -1;
+        return isDeviceLocal * 100 + isHostCoherent * 10 + !isHostCached;
+    }
+    return -1;
+}
+
+uint32_t memoryTypeSelector::MemoryTypeIndex(uint32_t memoryTypeBits, intent memoryIntent)
+{
+    uint64_t key = uint64_t(memoryTypeBits) << 8 | memoryIntent;
+    std::lock_guard<std::mutex> lock(mtx);
+    auto iterator = cache.find(key);
+    if (iterator != cache.end())
+        return iterator->second;
+    auto& physicalDeviceMemoryProperties = graphicsBase::Base().PhysicalDeviceMemoryProperties();
+    uint32_t memoryTypeIndex = UINT32_MAX;
+    int32_t bestScore = -1;
+    VkDeviceSize bestHeapSize = 0;
+    for (uint32_t i = 0; i < physicalDeviceMemoryProperties.memoryTypeCount; i++) {
+        if (!(memoryTypeBits & 1 << i))
+            continue;
+        const VkMemoryType& memoryType = physicalDeviceMemoryProperties.memoryTypes[i];
+        int32_t score = Score(memoryType.propertyFlags, memoryIntent);
+        VkDeviceSize heapSize = physicalDeviceMemoryProperties.memoryHeaps[memoryType.heapIndex].size;
+        if (score > bestScore ||
+            score == bestScore && score >= 0 && heapSize > bestHeapSize) {
+            memoryTypeIndex = i;
+            bestScore = score;
+            bestHeapSize = heapSize;
+        }
+    }
+    if (memoryTypeIndex == UINT32_MAX)
+        qDebug("[ memoryTypeSelector ] ERROR\nFailed to find any memory type for the intent: %d\n", int32_t(memoryIntent));
+    cache.emplace(key, memoryTypeIndex);
+    return memoryTypeIndex;
+}
+
+void memoryTypeSelector::ClearCache()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    cache.clear();
+}
+
+deviceMemoryAllocator::block::~block()
+{
+    if (!handle)
+        return;
+    if (mapCount)
+        vkUnmapMemory(graphicsBase::Base().Device(), handle);
+    graphicsBase::Base().RecordMemoryFree(memoryTypeIndex, size);
+    vkFreeMemory(graphicsBase::Base().Device(), handle, nullptr);
+    handle = (VkDeviceMemory)VK_NULL_HANDLE;
+}
+
+void deviceMemoryAllocator::block::InsertFreeRange(VkDeviceSize offset, VkDeviceSize size)
+{
+    freeRanges_offset.emplace(offset, size);
+    freeRanges_size.emplace(size, offset);
+}
+
+void deviceMemoryAllocator::block::EraseFreeRange(std::map<VkDeviceSize, VkDeviceSize>::iterator iterator)
+{
+    auto range = freeRanges_size.equal_range(iterator->second);
+    for (auto i = range.first; i != range.second; i++)
+        if (i->second == iterator->first) {
+            freeRanges_size.erase(i);
+            break;
+        }
+    freeRanges_offset.erase(iterator);
+}
+
+result_t deviceMemoryAllocator::block::Allocate(uint32_t memoryTypeIndex, VkDeviceSize size)
+{
+    VkMemoryAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocateInfo.allocationSize = size;
+    allocateInfo.memoryTypeIndex = memoryTypeIndex;
+    //内存块被多个资源共用，启用了bufferDeviceAddress时一律允许取得地址
+    VkMemoryAllocateFlagsInfo memoryAllocateFlagsInfo = {
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO,
+        nullptr,
+        VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT
+    };
+    if (graphicsBase::Base().BufferDeviceAddressEnabled())
+        allocateInfo.pNext = &memoryAllocateFlagsInfo;
+    if (VkResult result = vkAllocateMemory(graphicsBase::Base().Device(), &allocateInfo, nullptr, &handle)) {
+        qDebug("[ deviceMemoryAllocator ] ERROR\nFailed to allocate a memory block!\nError code: %d\n", int32_t(result));
+        return result;
+    }
+    this->size = size;
+    this->memoryTypeIndex = memoryTypeIndex;
+    InsertFreeRange(0, size);
+    graphicsBase::Base().RecordMemoryAllocation(memoryTypeIndex, size);
+    return VK_SUCCESS;
+}
+
+bool deviceMemoryAllocator::block::Suballocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+{
+    //从能容纳size的最小空闲区间开始找，因对齐而放不下时再看更大的区间
+    for (auto i = freeRanges_size.lower_bound(size); i != freeRanges_size.end(); i++) {
+        VkDeviceSize rangeOffset = i->second;
+        VkDeviceSize rangeSize = i->first;
+        VkDeviceSize alignedOffset = (rangeOffset + alignment - 1) / alignment * alignment;
+        if (alignedOffset + size > rangeOffset + rangeSize)
+            continue;
+        EraseFreeRange(freeRanges_offset.find(rangeOffset));
+        //对齐产生的前部空隙和用剩的后部仍作为空闲区间
+        if (alignedOffset > rangeOffset)
+            InsertFreeRange(rangeOffset, alignedOffset - rangeOffset);
+        if (alignedOffset + size < rangeOffset + rangeSize)
+            InsertFreeRange(alignedOffset + size, rangeOffset + rangeSize - alignedOffset - size);
+        usedSize += size;
+        offset = alignedOffset;
+        return true;
+    }
+    return false;
+}
+
+void deviceMemoryAllocator::block::Free(VkDeviceSize offset, VkDeviceSize size)
+{
+    usedSize -= size;
+    //与前后相邻的空闲区间合并
+    auto next = freeRanges_offset.lower_bound(offset);
+    if (next != freeRanges_offset.end() &&
+        next->first == offset + size) {
+        size += next->second;
+        EraseFreeRange(next);
+        next = freeRanges_offset.lower_bound(offset);
+    }
+    if (next != freeRanges_offset.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            size += prev->second;
+            EraseFreeRange(prev);
+        }
+    }
+    InsertFreeRange(offset, size);
+}
+
+deviceMemoryAllocator::deviceMemoryAllocator()
+{
+    graphicsBase::Base().AddCallback_DestroyDevice([] { Get().Clear(); });
+}
+
+bool deviceMemoryAllocator::Contains(const block* pBlock) const
+{
+    for (auto& i : pools)
+        for (auto& pool : i)
+            for (auto& j : pool)
+                if (j.get() == pBlock)
+                    return true;
+    return false;
+}
+
+VkDeviceSize deviceMemoryAllocator::PreferredBlockSize(uint32_t memoryTypeIndex) const
+{
+    auto& physicalDeviceMemoryProperties = graphicsBase::Base().PhysicalDeviceMemoryProperties();
+    VkDeviceSize heapSize = physicalDeviceMemoryProperties.memoryHeaps[physicalDeviceMemoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+    //小的堆（比如部分设备上256MB的device local且host visible的堆）不宜一次占去太多
+    if (heapSize <= VkDeviceSize(1) << 30)
+        return std::min(blockSize, heapSize / 8);
+    return blockSize;
+}
+
+result_t deviceMemoryAllocator::Allocate(uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceSize alignment, bool linear,
+                                         block*& pBlock, VkDeviceSize& offset, VkDeviceSize& allocatedSize)
+{
+    //非host coherent的内存在刷新时以nonCoherentAtomSize为单位，令子分配按其对齐，以免刷新到相邻的资源
+    auto& physicalDeviceMemoryProperties = graphicsBase::Base().PhysicalDeviceMemoryProperties();
+    VkMemoryPropertyFlags memoryProperties = physicalDeviceMemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+    if (memoryProperties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT &&
+        !(memoryProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+        const VkDeviceSize& nonCoherentAtomSize = graphicsBase::Base().PhysicalDeviceProperties().limits.nonCoherentAtomSize;
+        alignment = std::max(alignment, nonCoherentAtomSize);
+        size = (size + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize;
+    }
+    alignment = std::max(alignment, VkDeviceSize(1));
+    std::lock_guard<std::mutex> lock(mtx);
+    auto& pool = pools[memoryTypeIndex][!linear];
+    VkDeviceSize preferredBlockSize = PreferredBlockSize(memoryTypeIndex);
+    bool dedicated = size > preferredBlockSize / 2;
+    if (!dedicated)
+        for (auto& i : pool)
+            if (!i->dedicated &&
+                i->Suballocate(size, alignment, offset)) {
+                pBlock = i.get();
+                allocatedSize = size;
+                return VK_SUCCESS;
+            }
+    std::unique_ptr<block> newBlock = std::make_unique<block>();
+    if (VkResult result = newBlock->Allocate(memoryTypeIndex, dedicated ? size : preferredBlockSize))
+        return result;
+    newBlock->dedicated = dedicated;
+    newBlock->Suballocate(size, alignment, offset);
+    pBlock = newBlock.get();
+    allocatedSize = size;
+    pool.push_back(std::move(newBlock));
+    return VK_SUCCESS;
+}
+
+void deviceMemoryAllocator::Free(block* pBlock, VkDeviceSize offset, VkDeviceSize size)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    //先确认内存块仍存在，再访问其成员
+    for (auto& i : pools)
+        for (auto& pool : i) {
+            auto iterator = std::find_if(pool.begin(), pool.end(), [pBlock](const std::unique_ptr<block>& i) { return i.get() == pBlock; });
+            if (iterator == pool.end())
+                continue;
+            pBlock->Free(offset, size);
+            if (pBlock->usedSize)
+                return;
+            //独占的内存块立刻释放，共享的内存块保留一个空块以免反复分配
+            if (pBlock->dedicated ||
+                std::any_of(pool.begin(), pool.end(), [pBlock](const std::unique_ptr<block>& i) { return i.get() != pBlock && !i->dedicated && !i->usedSize; }))
+                pool.erase(iterator);
+            return;
+        }
+    //找不到说明内存块已随逻辑设备的销毁被释放，无需处理
+}
+
+result_t deviceMemoryAllocator::MapBlock(block* pBlock, void*& pData)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!pBlock->mapCount)
+        if (VkResult result = vkMapMemory(graphicsBase::Base().Device(), pBlock->handle, 0, VK_WHOLE_SIZE, 0, &pBlock->pMappedData)) {
+            qDebug("[ deviceMemoryAllocator ] ERROR\nFailed to map the memory block!\nError code: %d\n", int32_t(result));
+            return result;
+        }
+    pBlock->mapCount++;
+    pData = pBlock->pMappedData;
+    return VK_SUCCESS;
+}
+
+void deviceMemoryAllocator::UnmapBlock(block* pBlock)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    //内存块可能已随逻辑设备的销毁被释放
+    if (!Contains(pBlock))
+        return;
+    if (pBlock->mapCount &&
+        !--pBlock->mapCount) {
+        vkUnmapMemory(graphicsBase::Base().Device(), pBlock->handle);
+        pBlock->pMappedData = nullptr;
+    }
+}
+
+void deviceMemoryAllocator::Clear()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    for (auto& i : pools)
+        for (auto& pool : i)
+            pool.clear();
+}
+
+deferredDestructionQueue::deferredDestructionQueue()
+{
+    graphicsBase::Base().AddCallback_DestroyDevice([] { Get().DestroyAll(); });
+}
+
+void deferredDestructionQueue::FrameCount(uint32_t frameCount)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    frameCount = std::max(frameCount, 1u);
+    if (currentFrame >= frameCount)
+        currentFrame = 0;
+    //并入当前槽位的对象要再经过frameCount帧才销毁，不会早于原本的时机
+    for (size_t i = frameCount; i < frames.size(); i++)
+        std::move(frames[i].begin(), frames[i].end(), std::back_inserter(frames[currentFrame]));
+    frames.resize(frameCount);
+}
+
+void deferredDestructionQueue::PushCallback(std::function<void()> destroyer)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    frames[currentFrame].push_back(std::move(destroyer));
+}
+
+void deferredDestructionQueue::NextFrame()
+{
+    std::vector<std::function<void()>> destroyers;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        currentFrame = (currentFrame + 1) % frames.size();
+        destroyers.swap(frames[currentFrame]);
+    }
+    //在锁外销毁，以便析构函数中再次调用Push(...)
+    for (auto& i : destroyers)
+        i();
+}
+
+void deferredDestructionQueue::DestroyAll()
+{
+    std::vector<std::vector<std::function<void()>>> destroyers;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        destroyers.resize(frames.size());
+        for (size_t i = 0; i < frames.size(); i++)
+            destroyers[i].swap(frames[i]);
+    }
+    for (auto& i : destroyers)
+        for (auto& j : i)
+            j();
+}
@@ -152,6 +152,8 @@ namespace vulkan {
         uint32_t queueFamilyIndex_graphics = VK_QUEUE_FAMILY_IGNORED;
         uint32_t queueFamilyIndex_presentation = VK_QUEUE_FAMILY_IGNORED;
         uint32_t queueFamilyIndex_compute = VK_QUEUE_FAMILY_IGNORED;
+        //仅支持数据传输的队列族，通常对应独立的DMA引擎，没有这样的队列族时与queueFamilyIndex_graphics相同
+        uint32_t queueFamilyIndex_transfer = VK_QUEUE_FAMILY_IGNORED;
 
          //图形队列
         VkQueue queue_graphics;
@@ -159,11 +161,17 @@ namespace vulkan {
         VkQueue queue_presentation;
         //计算队列
         VkQueue queue_compute;
+        //传输队列，没有专用的传输队列族时与queue_graphics相同
+        VkQueue queue_transfer;
 
         std::vector<const char*> deviceExtensions;
+        //若物理设备支持（需要Vulkan1.2），CreateDevice(...)会启用bufferDeviceAddress特性，此时所有设备内存都带VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT分配
+        bool bufferDeviceAddressEnabled = false;
 
         //该函数被DeterminePhysicalDevice(...)调用，用于检查物理设备是否满足所需的队列族类型，并将对应的队列族索引返回到queueFamilyIndices，执行成功时直接将索引写入相应成员变量
         VkResult GetQueueFamilyIndices(VkPhysicalDevice physicalDevice, bool enableGraphicsQueue, bool enableComputeQueue, uint32_t (&queueFamilyIndices)[3]);
+        //该函数被CreateDevice(...)调用，返回仅支持数据传输（不支持图形和计算）的队列族索引，没有时返回VK_QUEUE_FAMILY_IGNORED
+        uint32_t GetQueueFamilyIndex_Transfer(VkPhysicalDevice physicalDevice) const;
     public:
         //Getter
         VkPhysicalDevice PhysicalDevice() const;
@@ -175,9 +183,15 @@ namespace vulkan {
         uint32_t QueueFamilyIndex_Graphics() const;
         uint32_t QueueFamilyIndex_Presentation() const;
         uint32_t QueueFamilyIndex_Compute() const;
+        uint32_t QueueFamilyIndex_Transfer() const;
         VkQueue Queue_Graphics() const;
         VkQueue Queue_Presentation() const;
         VkQueue Queue_Compute() const;
+        VkQueue Queue_Transfer() const;
+        //是否有专用的传输队列族，若有，在传输队列上写入的独占资源须转移队列族所有权后才能在图形队列上使用
+        bool HasDedicatedTransferQueue() const;
+        //是否启用了bufferDeviceAddress特性，若是，以VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT创建的缓冲区可通过DeviceAddress()取得地址，在着色器中以指针访问
+        bool BufferDeviceAddressEnabled() const;
         const std::vector<const char*>& DeviceExtensions() const;
         //该函数用于创建逻辑设备前
         void AddDeviceExtension(const char* extensionName);
@@ -248,10 +262,24 @@ namespace vulkan {
     public:
         void AddCallback_CreateDevice(std::function<void()> function);
         void AddCallback_DestroyDevice(std::function<void()> function);
-/*等待逻辑设备空闲*/
+/*等待逻辑设备空闲，同时锁住所有队列（vkDeviceWaitIdle(...)要求所有队列的外部同步），成功后销毁deferredDestructionQueue中的所有对象*/
     public:
         VkResult WaitIdle() const;
 
+/*
+ * 队列的外部同步：同一VkQueue不能被多个线程同时用于vkQueueSubmit(...)、vkQueuePresentKHR(...)、vkQueueWaitIdle(...)
+ *    每个不同的VkQueue一个互斥锁，按句柄而非用途加锁：图形、呈现、计算、传输队列为同一VkQueue时共用一个锁
+ *    本类中使用队列的函数都已加锁，可在多个线程中调用；在类外直接调用vkQueue*(...)前须先以LockQueue(...)加锁
+ *    锁只在调用Vulkan函数期间持有，例如PresentImage(...)在重建交换链前已解锁
+ */
+    private:
+        //依次对应queue_graphics、queue_presentation、queue_compute、queue_transfer
+        mutable std::mutex queue_mtxs[4];
+        std::mutex& QueueMutex(VkQueue queue) const;
+    public:
+        //锁住queue对应的互斥锁，返回的锁析构时解锁
+        std::unique_lock<std::mutex> LockQueue(VkQueue queue) const;
+
 /*
  * 重建逻辑设备
  *    比如:运行过程中切换显卡，或逻辑设备丢失等情况
@@ -272,6 +300,8 @@ namespace vulkan {
 
 //提交命令缓冲区
     public:
+        //将多个提交信息在一次vkQueueSubmit(...)中提交到queue，各提交信息的sType由该函数填写
+        result_t SubmitCommandBuffers(VkQueue queue, arrayRef<VkSubmitInfo> submitInfos, VkFence fence = (VkFence)VK_NULL_HANDLE) const;
         //提交命令缓冲区到图形队列
         result_t SubmitCommandBuffer_Graphics(VkSubmitInfo& submitInfo, VkFence fence = (VkFence)VK_NULL_HANDLE) const;
         //提交命令缓冲区到图形队列的常用参数
@@ -290,6 +320,14 @@ namespace vulkan {
         //将命令缓冲区提交的计算队列只使用栅栏常用参数
         result_t SubmitCommandBuffer_Compute(VkCommandBuffer commandBuffer, VkFence fence = (VkFence)VK_NULL_HANDLE) const;
 
+        //将命令缓冲区提交到传输队列
+        result_t SubmitCommandBuffer_Transfer(VkSubmitInfo& submitInfo, VkFence fence = (VkFence)VK_NULL_HANDLE) const;
+
+        //将命令缓冲区提交到传输队列的常用参数，semaphore_transferIsOver用于通知图形队列接收资源的所有权
+        result_t SubmitCommandBuffer_Transfer(VkCommandBuffer commandBuffer,
+            VkSemaphore semaphore_transferIsOver = (VkSemaphore)VK_NULL_HANDLE,
+            VkFence fence = (VkFence)VK_NULL_HANDLE) const;
+
 //呈现图像
         result_t PresentImage(VkPresentInfoKHR& presentInfo);
         //呈现图像的常用参数
@@ -302,6 +340,47 @@ namespace vulkan {
 //内存屏障
     public:
         void CmdTransferImageOwnership(VkCommandBuffer commandBuffer) const;
+
+/*设备内存统计
+ * 1.VkDeviceMemory层面：存活的分配数、按内存类型和堆统计的字节数及峰值，由deviceMemory和deviceMemoryAllocator的内存块记录
+ * 2.对象层面：按封装类（bufferMemory、imageMemory、stagingBuffer）统计的存活对象数和字节数，子分配的对象按其占用的大小计
+ * 3.若物理设备支持VK_EXT_memory_budget，CreateDevice(...)会启用该扩展，MemoryStatistics()一并取得驱动报告的各堆预算和用量
+ *  注意:长时间运行的程序可定期调用PrintMemoryStatistics()，在分配失败前发现内存的持续增长
+*/
+    public:
+        enum memoryObjectType :uint8_t {
+            memoryObject_other,
+            memoryObject_bufferMemory,
+            memoryObject_imageMemory,
+            memoryObject_stagingBuffer,
+            memoryObject_count
+        };
+        struct memoryStatistics {
+            uint32_t allocationCount;                                //存活的VkDeviceMemory数量
+            uint32_t peakAllocationCount;
+            VkDeviceSize allocatedSize;                              //存活的VkDeviceMemory的总大小
+            VkDeviceSize peakAllocatedSize;
+            VkDeviceSize allocatedSize_memoryType[VK_MAX_MEMORY_TYPES];
+            VkDeviceSize allocatedSize_heap[VK_MAX_MEMORY_HEAPS];
+            VkDeviceSize peakAllocatedSize_heap[VK_MAX_MEMORY_HEAPS];
+            uint32_t objectCount[memoryObject_count];                //按封装类统计的存活对象数
+            VkDeviceSize objectSize[memoryObject_count];
+            bool budgetAvailable;                                    //为true时以下两项有效，来自VK_EXT_memory_budget
+            VkDeviceSize budget_heap[VK_MAX_MEMORY_HEAPS];
+            VkDeviceSize usage_heap[VK_MAX_MEMORY_HEAPS];            //驱动报告的用量，包括其他进程和驱动内部的分配
+        };
+    private:
+        memoryStatistics statistics = {};
+        mutable std::mutex statistics_mtx;
+        bool memoryBudgetEnabled = false;
+    public:
+        memoryStatistics MemoryStatistics() const;
+        void PrintMemoryStatistics() const;
+        //以下函数由deviceMemory和deviceMemoryAllocator调用
+        void RecordMemoryAllocation(uint32_t memoryTypeIndex, VkDeviceSize size);
+        void RecordMemoryFree(uint32_t memoryTypeIndex, VkDeviceSize size);
+        void RecordObjectAllocation(memoryObjectType type, VkDeviceSize size);
+        void RecordObjectFree(memoryObjectType type, VkDeviceSize size);
     };
 
 /*  CPU                             GPU
@@ -598,6 +677,15 @@ namespace vulkan {
         void FreeBuffers(arrayRef<commandBuffer> buffers) const {
             FreeBuffers({ &buffers[0].handle, buffers.Count() });
         }
+        //将池中所有命令缓冲区一并重置为初始状态，比逐个重置命令缓冲区开销更小，且不需要VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT
+        //调用前须确保池中的命令缓冲区都已执行完毕
+        result_t Reset(VkCommandPoolResetFlags flags = 0) const {
+            VkResult result = vkResetCommandPool(graphicsBase::Base().Device(), handle, flags);
+            if (result){
+                qDebug("[ commandPool ] ERROR\nFailed to reset the command pool!\nError code: %d\n", int32_t(result));
+            }
+            return result;
+        }
 
         result_t Create(VkCommandPoolCreateInfo& createInfo){
             createInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -805,18 +893,142 @@ namespace vulkan {
         }
     };
 
+/*内存类型选择策略
+ * 1.按用途（intent）而非固定的内存属性来选择内存类型，对每个满足memoryTypeBits的内存类型打分，取最高分者
+ * 2.分数相同时选所在堆更大的内存类型
+ * 3.结果按(memoryTypeBits, intent)缓存，逻辑设备销毁时清空（重建时可能换了物理设备）
+ *
+ *  intent        必需的属性        优先的属性
+ *  gpuOnly       -                 DEVICE_LOCAL，且不占用host visible的内存
+ *  deviceLocal   DEVICE_LOCAL      HOST_VISIBLE（可省去暂存缓冲区）
+ *  upload        HOST_VISIBLE      HOST_COHERENT，非HOST_CACHED（写合并），非DEVICE_LOCAL
+ *  readback      HOST_VISIBLE      HOST_CACHED
+ *  dynamic       HOST_VISIBLE      DEVICE_LOCAL（Resizable BAR），HOST_COHERENT
+ */
+    class memoryTypeSelector {
+    public:
+        enum intent :uint8_t {
+            gpuOnly,     //仅由GPU访问，比如纹理、渲染目标
+            deviceLocal, //由GPU频繁访问，偶尔由CPU更新，比如顶点缓冲区
+            upload,      //CPU写入后由GPU读取一次，比如暂存缓冲区
+            readback,    //GPU写入后由CPU读取，比如截图、计算结果
+            dynamic      //CPU每帧写入、GPU每帧读取，比如uniform缓冲区
+        };
+    private:
+        std::unordered_map<uint64_t, uint32_t> cache;
+        std::mutex mtx;
+        //--------------------
+        memoryTypeSelector();
+        memoryTypeSelector(memoryTypeSelector&&) = delete;
+        ~memoryTypeSelector() = default;
+        //不满足必需的属性时返回-1
+        static int32_t Score(VkMemoryPropertyFlags memoryProperties, intent memoryIntent);
+    public:
+        static memoryTypeSelector& Get() {
+            static memoryTypeSelector& singleton = *new memoryTypeSelector;
+            return singleton;
+        }
+        //找不到合适的内存类型时返回UINT32_MAX
+        uint32_t MemoryTypeIndex(uint32_t memoryTypeBits, intent memoryIntent);
+        void ClearCache();
+    };
+
+/*设备内存子分配器
+ * 1.每次vkAllocateMemory(...)都有不小的开销，且分配次数受maxMemoryAllocationCount限制（不少设备上仅4096）
+ * 2.按内存类型索引维护若干大块VkDeviceMemory，bufferMemory和imageMemory从中切出一段，绑定在该段的起始位置
+ * 3.线性资源（缓冲区、线性图像）与非线性资源（最优排列的图像）放在不同的内存块中，以此满足bufferImageGranularity
+ * 4.大于内存块一半大小的资源独占一个大小恰好的内存块
+ * 5.lazily allocated的内存类型（如tile-based GPU上的临时附件）不经过分配器，由deviceMemory单独分配
+ *
+ *  VkDeviceMemory(block)
+ *  ├── [offset 0]     vertexBuffer
+ *  ├── [offset 256]   uniformBuffer
+ *  ├── (free)
+ *  └── [offset 4096]  storageBuffer
+ */
+    class deviceMemoryAllocator {
+    public:
+        class block {
+            friend class deviceMemoryAllocator;
+            VkDeviceMemory handle = (VkDeviceMemory)VK_NULL_HANDLE;
+            VkDeviceSize size = 0;
+            VkDeviceSize usedSize = 0;
+            uint32_t memoryTypeIndex = 0;
+            bool dedicated = false;
+            //空闲区间，分别以起始位置和大小为键，前者用于合并相邻区间，后者用于best-fit查找
+            std::map<VkDeviceSize, VkDeviceSize> freeRanges_offset;
+            std::multimap<VkDeviceSize, VkDeviceSize> freeRanges_size;
+            //同一VkDeviceMemory不能被同时映射多次，因此整块映射，以引用计数管理
+            void* pMappedData = nullptr;
+            uint32_t mapCount = 0;
+            //--------------------
+            void InsertFreeRange(VkDeviceSize offset, VkDeviceSize size);
+            void EraseFreeRange(std::map<VkDeviceSize, VkDeviceSize>::iterator iterator);
+            result_t Allocate(uint32_t memoryTypeIndex, VkDeviceSize size);
+            bool Suballocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+            void Free(VkDeviceSize offset, VkDeviceSize size);
+        public:
+            block() = default;
+            block(block&&) = delete;
+            ~block();
+            //Getter
+            DefineHandleTypeOperator(VkDeviceMemory, handle);
+            VkDeviceSize Size() const { return size; }
+            VkDeviceSize UsedSize() const { return usedSize; }
+            uint32_t MemoryTypeIndex() const { return memoryTypeIndex; }
+            bool Dedicated() const { return dedicated; }
+        };
+    private:
+        //[内存类型索引][0:线性资源, 1:非线性资源]
+        std::vector<std::unique_ptr<block>> pools[VK_MAX_MEMORY_TYPES][2];
+        VkDeviceSize blockSize = 64 << 20;
+        std::mutex mtx;
+        //--------------------
+        deviceMemoryAllocator();
+        deviceMemoryAllocator(deviceMemoryAllocator&&) = delete;
+        ~deviceMemoryAllocator() = default;
+        VkDeviceSize PreferredBlockSize(uint32_t memoryTypeIndex) const;
+        //该函数用于确认内存块仍存在，调用前须已锁定mtx
+        bool Contains(const block* pBlock) const;
+    public:
+        static deviceMemoryAllocator& Get() {
+            //不随静态对象析构，内存块由销毁逻辑设备时的回调函数释放，以免其他静态对象析构时访问已析构的分配器
+            static deviceMemoryAllocator& singleton = *new deviceMemoryAllocator;
+            return singleton;
+        }
+        //Getter
+        VkDeviceSize BlockSize() const { return blockSize; }
+        //Non-const Function
+        //该函数用于设置之后新建内存块的大小，已有的内存块不受影响
+        void BlockSize(VkDeviceSize size) { blockSize = size; }
+        //从内存块中切出一段，linear指示资源是否为线性资源，allocatedSize为实际占用的大小（可能因对齐而大于size）
+        result_t Allocate(uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceSize alignment, bool linear,
+                          block*& pBlock, VkDeviceSize& offset, VkDeviceSize& allocatedSize);
+        void Free(block* pBlock, VkDeviceSize offset, VkDeviceSize size);
+        result_t MapBlock(block* pBlock, void*& pData);
+        void UnmapBlock(block* pBlock);
+        //该函数用于释放所有内存块，在销毁逻辑设备时执行
+        void Clear();
+    };
+
 //封装deviceMemory类
     class deviceMemory {
         VkDeviceMemory handle = (VkDeviceMemory)VK_NULL_HANDLE;
         VkDeviceSize allocationSize = 0;            //实际分配的内存大小
         VkMemoryPropertyFlags memoryProperties = 0; //内存属性
+        VkDeviceSize memoryOffset = 0;              //在VkDeviceMemory中的起始位置，仅子分配时可能非0
+        deviceMemoryAllocator::block* pBlock = nullptr; //子分配时所属的内存块，为nullptr说明独占handle
+        void* pMappedData = nullptr;                //持久映射时，指向本对象内存起始位置的指针
+        uint32_t memoryTypeIndex = 0;
+        graphicsBase::memoryObjectType objectType = graphicsBase::memoryObject_other; //用于内存统计，析构时不重置
         //--------------------
-        //该函数用于在映射内存区时，调整非host coherent的内存区域的范围
+        //该函数用于在映射内存区时，调整非host coherent的内存区域的范围，offset为在VkDeviceMemory中的起始位置
         VkDeviceSize AdjustNonCoherentMemoryRange(VkDeviceSize& size, VkDeviceSize& offset) const {
             const VkDeviceSize& nonCoherentAtomSize = graphicsBase::Base().PhysicalDeviceProperties().limits.nonCoherentAtomSize;
+            VkDeviceSize memorySize = pBlock ? pBlock->Size() : allocationSize;
             VkDeviceSize _offset = offset;
             offset = offset / nonCoherentAtomSize * nonCoherentAtomSize;
-            size = std::min((size + _offset + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize, allocationSize) - offset;
+            size = std::min((size + _offset + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize, memorySize) - offset;
             return _offset - offset;
         }
     protected:
@@ -838,27 +1050,98 @@ namespace vulkan {
             MoveHandle;
             allocationSize = other.allocationSize;
             memoryProperties = other.memoryProperties;
+            memoryOffset = other.memoryOffset;
+            pBlock = other.pBlock;
+            pMappedData = other.pMappedData;
+            memoryTypeIndex = other.memoryTypeIndex;
+            objectType = other.objectType;
             other.allocationSize = 0;
             other.memoryProperties = 0;
+            other.memoryOffset = 0;
+            other.pBlock = nullptr;
+            other.pMappedData = nullptr;
+        }
+        ~deviceMemory() {
+            UnmapPersistently();
+            if (handle)
+                graphicsBase::Base().RecordObjectFree(objectType, allocationSize);
+            if (pBlock) {
+                deviceMemoryAllocator::Get().Free(pBlock, memoryOffset, allocationSize);
+                handle = (VkDeviceMemory)VK_NULL_HANDLE;
+            }
+            else if (handle) {
+                graphicsBase::Base().RecordMemoryFree(memoryTypeIndex, allocationSize);
+                DestroyHandleBy(vkFreeMemory);
+            }
+            allocationSize = 0;
+            memoryProperties = 0;
+            memoryOffset = 0;
+            pBlock = nullptr;
         }
-        ~deviceMemory() { DestroyHandleBy(vkFreeMemory); allocationSize = 0; memoryProperties = 0; }
         //Getter
         DefineHandleTypeOperator(VkDeviceMemory,handle);
         DefineAddressFunction;
         VkDeviceSize AllocationSize() const { return allocationSize; }
         VkMemoryPropertyFlags MemoryProperties() const { return memoryProperties; }
+        VkDeviceSize MemoryOffset() const { return memoryOffset; }
+        uint32_t MemoryTypeIndex() const { return memoryTypeIndex; }
+        graphicsBase::memoryObjectType ObjectType() const { return objectType; }
+        void* MappedData() const { return pMappedData; }
+        bool IsPersistentlyMapped() const { return pMappedData; }
         //Const Function
-        //映射host visible的内存区
+        //该函数返回按nonCoherentAtomSize调整后的VkMappedMemoryRange，offset为相对于本对象内存起始的位置
+        VkMappedMemoryRange MappedMemoryRange(VkDeviceSize size, VkDeviceSize offset = 0) const {
+            offset += memoryOffset;
+            AdjustNonCoherentMemoryRange(size, offset);
+            VkMappedMemoryRange mappedMemoryRange = {};
+            mappedMemoryRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+            mappedMemoryRange.memory = handle;
+            mappedMemoryRange.offset = offset;
+            mappedMemoryRange.size = size;
+            return mappedMemoryRange;
+        }
+        //将CPU写入的数据刷新到设备，仅对非host coherent的内存有实际操作，offset为相对于本对象内存起始的位置
+        result_t FlushMappedMemoryRange(VkDeviceSize size, VkDeviceSize offset = 0) const {
+            if (memoryProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+                return VK_SUCCESS;
+            VkMappedMemoryRange mappedMemoryRange = MappedMemoryRange(size, offset);
+            VkResult result = vkFlushMappedMemoryRanges(graphicsBase::Base().Device(), 1, &mappedMemoryRange);
+            if (result)
+                qDebug("[ deviceMemory ] ERROR\nFailed to flush the memory!\nError code: %d\n", int32_t(result));
+            return result;
+        }
+        //使设备写入的数据对CPU可见，仅对非host coherent的内存有实际操作
+        result_t InvalidateMappedMemoryRange(VkDeviceSize size, VkDeviceSize offset = 0) const {
+            if (memoryProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+                return VK_SUCCESS;
+            VkMappedMemoryRange mappedMemoryRange = MappedMemoryRange(size, offset);
+            VkResult result = vkInvalidateMappedMemoryRanges(graphicsBase::Base().Device(), 1, &mappedMemoryRange);
+            if (result)
+                qDebug("[ deviceMemory ] ERROR\nFailed to invalidate the memory!\nError code: %d\n", int32_t(result));
+            return result;
+        }
+        //映射host visible的内存区，若已持久映射，则直接返回缓存的指针
         result_t MapMemory(void*& pData, VkDeviceSize size, VkDeviceSize offset = 0) const {
-            VkDeviceSize inverseDeltaOffset;
+            if (pMappedData) {
+                pData = static_cast<uint8_t*>(pMappedData) + offset;
+                return InvalidateMappedMemoryRange(size, offset);
+            }
+            offset += memoryOffset;
+            VkDeviceSize inverseDeltaOffset = 0;
             if (!(memoryProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
                 inverseDeltaOffset = AdjustNonCoherentMemoryRange(size, offset);
-            if (VkResult result = vkMapMemory(graphicsBase::Base().Device(), handle, offset, size, 0, &pData)) {
+            //子分配的内存由所属内存块整块映射，在此基础上偏移
+            if (pBlock) {
+                if (VkResult result = deviceMemoryAllocator::Get().MapBlock(pBlock, pData))
+                    return result;
+                pData = static_cast<uint8_t*>(pData) + offset;
+            }
+            else if (VkResult result = vkMapMemory(graphicsBase::Base().Device(), handle, offset, size, 0, &pData)) {
                 qDebug("[ deviceMemory ] ERROR\nFailed to map the memory!\nError code: %d\n", int32_t(result));
                 return result;
             }
+            pData = static_cast<uint8_t*>(pData) + inverseDeltaOffset;
             if (!(memoryProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
-                pData = static_cast<uint8_t*>(pData) + inverseDeltaOffset;
                 VkMappedMemoryRange mappedMemoryRange = {};
                 mappedMemoryRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
                 mappedMemoryRange.memory = handle;
@@ -872,8 +1155,11 @@ namespace vulkan {
             }
             return VK_SUCCESS;
         }
-        //取消映射host visible的内存区
+        //取消映射host visible的内存区，若已持久映射，则只刷新而不取消映射
         result_t UnmapMemory(VkDeviceSize size, VkDeviceSize offset = 0) const {
+            if (pMappedData)
+                return FlushMappedMemoryRange(size, offset);
+            offset += memoryOffset;
             if (!(memoryProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
                 AdjustNonCoherentMemoryRange(size, offset);
                 VkMappedMemoryRange mappedMemoryRange = {};
@@ -887,10 +1173,14 @@ namespace vulkan {
                     return result;
                 }
             }
-            vkUnmapMemory(graphicsBase::Base().Device(), handle);
+            if (pBlock)
+                deviceMemoryAllocator::Get().UnmapBlock(pBlock);
+            else
+                vkUnmapMemory(graphicsBase::Base().Device(), handle);
             return VK_SUCCESS;
         }
         //BufferData(...)用于方便地更新设备内存区，适用于用memcpy(...)向内存区写入数据后立刻取消映射的情况
+        //若已持久映射，则仅有memcpy(...)，对于非host coherent的内存再加一次刷新
         result_t BufferData(const void* pData_src, VkDeviceSize size, VkDeviceSize offset = 0) const {
             void* pData_dst;
             if (VkResult result = MapMemory(pData_dst, size, offset))
@@ -910,22 +1200,164 @@ namespace vulkan {
             return UnmapMemory(size, offset);
         }
         //Non-const Function
+        //该函数用于在分配前指定内存统计中的分类
+        void ObjectType(graphicsBase::memoryObjectType type) { objectType = type; }
         result_t Allocate(VkMemoryAllocateInfo& allocateInfo) {
             if (allocateInfo.memoryTypeIndex >= graphicsBase::Base().PhysicalDeviceMemoryProperties().memoryTypeCount) {
                 qDebug("[ deviceMemory ] ERROR\nInvalid memory type index!\n");
                 return VK_RESULT_MAX_ENUM; //没有合适的错误代码，别用VK_ERROR_UNKNOWN
             }
             allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-            if (VkResult result = vkAllocateMemory(graphicsBase::Base().Device(), &allocateInfo, nullptr, &handle)) {
+            //启用了bufferDeviceAddress时，绑定到该内存的缓冲区可能需要取得地址
+            VkMemoryAllocateFlagsInfo memoryAllocateFlagsInfo = {
+                VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO,
+                allocateInfo.pNext,
+                VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT
+            };
+            if (graphicsBase::Base().BufferDeviceAddressEnabled())
+                allocateInfo.pNext = &memoryAllocateFlagsInfo;
+            VkResult result = vkAllocateMemory(graphicsBase::Base().Device(), &allocateInfo, nullptr, &handle);
+            allocateInfo.pNext = memoryAllocateFlagsInfo.pNext;
+            if (result) {
                 qDebug("[ deviceMemory ] ERROR\nFailed to allocate memory!\nError code: %d\n", int32_t(result));
                 return result;
             }
             //记录实际分配的内存大小
             allocationSize = allocateInfo.allocationSize;
+            memoryTypeIndex = allocateInfo.memoryTypeIndex;
             //取得内存属性
             memoryProperties = graphicsBase::Base().PhysicalDeviceMemoryProperties().memoryTypes[allocateInfo.memoryTypeIndex].propertyFlags;
+            graphicsBase::Base().RecordMemoryAllocation(memoryTypeIndex, allocationSize);
+            graphicsBase::Base().RecordObjectAllocation(objectType, allocationSize);
             return VK_SUCCESS;
         }
+        //从deviceMemoryAllocator的内存块中子分配，alignment来自VkMemoryRequirements，linear指示资源是否为线性资源（缓冲区或线性图像）
+        //lazily allocated的内存类型不子分配：其物理内存按需提交，大块的VkDeviceMemory会使之失去意义，故独占一块VkDeviceMemory
+        result_t Allocate(VkMemoryAllocateInfo& allocateInfo, VkDeviceSize alignment, bool linear) {
+            if (allocateInfo.memoryTypeIndex >= graphicsBase::Base().PhysicalDeviceMemoryProperties().memoryTypeCount) {
+                qDebug("[ deviceMemory ] ERROR\nInvalid memory type index!\n");
+                return VK_RESULT_MAX_ENUM; //没有合适的错误代码，别用VK_ERROR_UNKNOWN
+            }
+            if (graphicsBase::Base().PhysicalDeviceMemoryProperties().memoryTypes[allocateInfo.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)
+                return Allocate(allocateInfo);
+            if (VkResult result = deviceMemoryAllocator::Get().Allocate(allocateInfo.memoryTypeIndex, allocateInfo.allocationSize, alignment, linear,
+                                                                        pBlock, memoryOffset, allocationSize))
+                return result;
+            handle = *pBlock;
+            memoryTypeIndex = allocateInfo.memoryTypeIndex;
+            memoryProperties = graphicsBase::Base().PhysicalDeviceMemoryProperties().memoryTypes[allocateInfo.memoryTypeIndex].propertyFlags;
+            graphicsBase::Base().RecordObjectAllocation(objectType, allocationSize);
+            return VK_SUCCESS;
+        }
+        //持久映射整个内存区，之后的MapMemory(...)、BufferData(...)、RetrieveData(...)不再调用vkMapMemory(...)和vkUnmapMemory(...)
+        result_t MapPersistently() {
+            if (pMappedData)
+                return VK_SUCCESS;
+            if (!(memoryProperties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+                qDebug("[ deviceMemory ] ERROR\nMemory is not host visible!\n");
+                return VK_RESULT_MAX_ENUM; //没有合适的错误代码，别用VK_ERROR_UNKNOWN
+            }
+            void* pData;
+            if (pBlock) {
+                if (VkResult result = deviceMemoryAllocator::Get().MapBlock(pBlock, pData))
+                    return result;
+                pMappedData = static_cast<uint8_t*>(pData) + memoryOffset;
+            }
+            else {
+                if (VkResult result = vkMapMemory(graphicsBase::Base().Device(), handle, 0, VK_WHOLE_SIZE, 0, &pData)) {
+                    qDebug("[ deviceMemory ] ERROR\nFailed to map the memory!\nError code: %d\n", int32_t(result));
+                    return result;
+                }
+                pMappedData = pData;
+            }
+            return VK_SUCCESS;
+        }
+        void UnmapPersistently() {
+            if (!pMappedData)
+                return;
+            if (pBlock)
+                deviceMemoryAllocator::Get().UnmapBlock(pBlock);
+            else
+                vkUnmapMemory(graphicsBase::Base().Device(), handle);
+            pMappedData = nullptr;
+        }
+    };
+
+/*mappedMemoryRangeBatch: 收集一帧内对多个deviceMemory的零散写入，合并后一次性刷新
+ * 1.Add(...)记录非host coherent的内存区，host coherent的内存区直接忽略
+ * 2.Flush()/Invalidate()前按(VkDeviceMemory, offset)排序，合并重叠或相邻的atom
+ * 3.整批只调用一次vkFlushMappedMemoryRanges(...)或vkInvalidateMappedMemoryRanges(...)
+ *
+ *  Add(A, 0~64)   Add(B, 0~256)   Add(A, 64~128)
+ *        \______________|______________/
+ *                  Flush() -> [A: 0~128] [B: 0~256]
+ */
+    class mappedMemoryRangeBatch {
+        std::vector<VkMappedMemoryRange> ranges;
+        //--------------------
+        //该函数用于排序并合并ranges中重叠或相邻的内存区
+        void Merge() {
+            std::sort(ranges.begin(), ranges.end(),
+                [](const VkMappedMemoryRange& a, const VkMappedMemoryRange& b) {
+                    if (a.memory != b.memory)
+                        return std::less<VkDeviceMemory>()(a.memory, b.memory);
+                    return a.offset < b.offset;
+                });
+            size_t count = 0;
+            for (size_t i = 0; i < ranges.size(); i++)
+                if (count &&
+                    ranges[count - 1].memory == ranges[i].memory &&
+                    ranges[count - 1].offset + ranges[count - 1].size >= ranges[i].offset) {
+                    VkMappedMemoryRange& last = ranges[count - 1];
+                    last.size = std::max(last.size, ranges[i].offset + ranges[i].size - last.offset);
+                }
+                else
+                    ranges[count++] = ranges[i];
+            ranges.resize(count);
+        }
+    public:
+        mappedMemoryRangeBatch() = default;
+        mappedMemoryRangeBatch(mappedMemoryRangeBatch&&) = default;
+        //Getter
+        uint32_t Count() const { return uint32_t(ranges.size()); }
+        //Non-const Function
+        //记录需要刷新或无效化的内存区，offset为相对于deviceMemory内存起始的位置
+        void Add(const deviceMemory& memory, VkDeviceSize size, VkDeviceSize offset = 0) {
+            if (memory.MemoryProperties() & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+                return;
+            ranges.push_back(memory.MappedMemoryRange(size, offset));
+        }
+        //该函数要求memory已持久映射，写入数据后只记录而不立刻刷新
+        result_t BufferData(const deviceMemory& memory, const void* pData_src, VkDeviceSize size, VkDeviceSize offset = 0) {
+            if (!memory.MappedData()) {
+                qDebug("[ mappedMemoryRangeBatch ] ERROR\nMemory is not persistently mapped!\n");
+                return VK_RESULT_MAX_ENUM; //没有合适的错误代码，别用VK_ERROR_UNKNOWN
+            }
+            memcpy(static_cast<uint8_t*>(memory.MappedData()) + offset, pData_src, size_t(size));
+            Add(memory, size, offset);
+            return VK_SUCCESS;
+        }
+        result_t Flush() {
+            if (ranges.empty())
+                return VK_SUCCESS;
+            Merge();
+            VkResult result = vkFlushMappedMemoryRanges(graphicsBase::Base().Device(), uint32_t(ranges.size()), ranges.data());
+            if (result)
+                qDebug("[ mappedMemoryRangeBatch ] ERROR\nFailed to flush the memory!\nError code: %d\n", int32_t(result));
+            ranges.clear();
+            return result;
+        }
+        result_t Invalidate() {
+            if (ranges.empty())
+                return VK_SUCCESS;
+            Merge();
+            VkResult result = vkInvalidateMappedMemoryRanges(graphicsBase::Base().Device(), uint32_t(ranges.size()), ranges.data());
+            if (result)
+                qDebug("[ mappedMemoryRangeBatch ] ERROR\nFailed to invalidate the memory!\nError code: %d\n", int32_t(result));
+            ranges.clear();
+            return result;
+        }
+        void Clear() { ranges.clear(); }
     };
 
 //创建buffer: 类似于cpu内存中的uint8_t* 属于线性数据
@@ -942,12 +1374,36 @@ namespace vulkan {
         DefineHandleTypeOperator(VkBuffer,handle);
         DefineAddressFunction;
         //Const Function
+        VkMemoryRequirements MemoryRequirements() const {
+            VkMemoryRequirements memoryRequirements;
+            vkGetBufferMemoryRequirements(graphicsBase::Base().Device(), handle, &memoryRequirements);
+            return memoryRequirements;
+        }
+        //缓冲区须以VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT创建，且已绑定内存
+        VkDeviceAddress DeviceAddress() const {
+            VkBufferDeviceAddressInfo bufferDeviceAddressInfo = {
+                VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+                nullptr,
+                handle
+            };
+            return vkGetBufferDeviceAddress(graphicsBase::Base().Device(), &bufferDeviceAddressInfo);
+        }
         VkMemoryAllocateInfo MemoryAllocateInfo(VkMemoryPropertyFlags desiredMemoryProperties) const {
+            return MemoryAllocateInfo(MemoryRequirements(), desiredMemoryProperties);
+        }
+        VkMemoryAllocateInfo MemoryAllocateInfo(memoryTypeSelector::intent memoryIntent) const {
+            return MemoryAllocateInfo(MemoryRequirements(), memoryIntent);
+        }
+        static VkMemoryAllocateInfo MemoryAllocateInfo(const VkMemoryRequirements& memoryRequirements, memoryTypeSelector::intent memoryIntent) {
+            VkMemoryAllocateInfo memoryAllocateInfo = {};
+            memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            memoryAllocateInfo.allocationSize = memoryRequirements.size;
+            memoryAllocateInfo.memoryTypeIndex = memoryTypeSelector::Get().MemoryTypeIndex(memoryRequirements.memoryTypeBits, memoryIntent);
+            return memoryAllocateInfo;
+        }
+        static VkMemoryAllocateInfo MemoryAllocateInfo(const VkMemoryRequirements& memoryRequirements, VkMemoryPropertyFlags desiredMemoryProperties) {
             VkMemoryAllocateInfo memoryAllocateInfo = {};
             memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-
-            VkMemoryRequirements memoryRequirements;
-            vkGetBufferMemoryRequirements(graphicsBase::Base().Device(), handle, &memoryRequirements);
             memoryAllocateInfo.allocationSize = memoryRequirements.size;
             memoryAllocateInfo.memoryTypeIndex = UINT32_MAX;
             auto& physicalDeviceMemoryProperties = graphicsBase::Base().PhysicalDeviceMemoryProperties();
@@ -984,8 +1440,9 @@ namespace vulkan {
 //封装bufferMemory类  -->包含buffer的创建与释放，内存由deviceMemory申请,然后绑定在一起
     class bufferMemory :public buffer, public deviceMemory {
     public:
-        bufferMemory() = default;
+        bufferMemory() { ObjectType(graphicsBase::memoryObject_bufferMemory); }
         bufferMemory(VkBufferCreateInfo& createInfo, VkMemoryPropertyFlags desiredMemoryProperties) {
+            ObjectType(graphicsBase::memoryObject_bufferMemory);
             Create(createInfo, desiredMemoryProperties);
         }
         bufferMemory(bufferMemory&& other) :
@@ -1004,34 +1461,65 @@ namespace vulkan {
         bool AreBound() const { return areBound; }
         using deviceMemory::AllocationSize;
         using deviceMemory::MemoryProperties;
+        using deviceMemory::MemoryOffset;
+        using deviceMemory::MemoryTypeIndex;
+        using deviceMemory::ObjectType;
+        using deviceMemory::MappedData;
+        using deviceMemory::IsPersistentlyMapped;
         //Const Function
+        using deviceMemory::FlushMappedMemoryRange;
+        using deviceMemory::InvalidateMappedMemoryRange;
         using deviceMemory::MapMemory;
         using deviceMemory::UnmapMemory;
         using deviceMemory::BufferData;
         using deviceMemory::RetrieveData;
         //Non-const Function
+        using deviceMemory::MapPersistently;
+        using deviceMemory::UnmapPersistently;
         //以下三个函数仅用于Create(...)可能执行失败的情况
         result_t CreateBuffer(VkBufferCreateInfo& createInfo) {
             return buffer::Create(createInfo);
         }
-        result_t AllocateMemory(VkMemoryPropertyFlags desiredMemoryProperties) {
-            VkMemoryAllocateInfo allocateInfo = MemoryAllocateInfo(desiredMemoryProperties);
+        //dedicated为true时独占一块VkDeviceMemory，否则从deviceMemoryAllocator的内存块中子分配
+        result_t AllocateMemory(VkMemoryPropertyFlags desiredMemoryProperties, bool dedicated = false) {
+            VkMemoryRequirements memoryRequirements = MemoryRequirements();
+            VkMemoryAllocateInfo allocateInfo = MemoryAllocateInfo(memoryRequirements, desiredMemoryProperties);
+            if (allocateInfo.memoryTypeIndex >= graphicsBase::Base().PhysicalDeviceMemoryProperties().memoryTypeCount)
+                return VK_RESULT_MAX_ENUM; //没有合适的错误代码，别用VK_ERROR_UNKNOWN
+            if (dedicated)
+                return Allocate(allocateInfo);
+            return Allocate(allocateInfo, memoryRequirements.alignment, true);
+        }
+        //按用途选择内存类型，见memoryTypeSelector
+        result_t AllocateMemory(memoryTypeSelector::intent memoryIntent, bool dedicated = false) {
+            VkMemoryRequirements memoryRequirements = MemoryRequirements();
+            VkMemoryAllocateInfo allocateInfo = MemoryAllocateInfo(memoryRequirements, memoryIntent);
             if (allocateInfo.memoryTypeIndex >= graphicsBase::Base().PhysicalDeviceMemoryProperties().memoryTypeCount)
                 return VK_RESULT_MAX_ENUM; //没有合适的错误代码，别用VK_ERROR_UNKNOWN
-            return Allocate(allocateInfo);
+            if (dedicated)
+                return Allocate(allocateInfo);
+            return Allocate(allocateInfo, memoryRequirements.alignment, true);
         }
         result_t BindMemory() {
-            if (VkResult result = buffer::BindMemory(Memory()))
+            if (VkResult result = buffer::BindMemory(Memory(), MemoryOffset()))
                 return result;
             areBound = true;
             return VK_SUCCESS;
         }
         //分配设备内存、创建缓冲、绑定
-        result_t Create(VkBufferCreateInfo& createInfo, VkMemoryPropertyFlags desiredMemoryProperties) {
+        result_t Create(VkBufferCreateInfo& createInfo, VkMemoryPropertyFlags desiredMemoryProperties, bool dedicated = false) {
+            VkResult result;
+            false || //这行用来应对Visual Studio中代码的对齐
+                (result = CreateBuffer(createInfo)) || //用||短路执行
+                (result = AllocateMemory(desiredMemoryProperties, dedicated)) ||
+                (result = BindMemory());
+            return result;
+        }
+        result_t Create(VkBufferCreateInfo& createInfo, memoryTypeSelector::intent memoryIntent, bool dedicated = false) {
             VkResult result;
             false || //这行用来应对Visual Studio中代码的对齐
                 (result = CreateBuffer(createInfo)) || //用||短路执行
-                (result = AllocateMemory(desiredMemoryProperties)) ||
+                (result = AllocateMemory(memoryIntent, dedicated)) ||
                 (result = BindMemory());
             return result;
         }
@@ -1086,12 +1574,27 @@ namespace vulkan {
         DefineHandleTypeOperator(VkImage,handle);
         DefineAddressFunction;
         //Const Function
+        VkMemoryRequirements MemoryRequirements() const {
+            VkMemoryRequirements memoryRequirements;
+            vkGetImageMemoryRequirements(graphicsBase::Base().Device(), handle, &memoryRequirements);
+            return memoryRequirements;
+        }
         VkMemoryAllocateInfo MemoryAllocateInfo(VkMemoryPropertyFlags desiredMemoryProperties) const {
+            return MemoryAllocateInfo(MemoryRequirements(), desiredMemoryProperties);
+        }
+        VkMemoryAllocateInfo MemoryAllocateInfo(memoryTypeSelector::intent memoryIntent) const {
+            return MemoryAllocateInfo(MemoryRequirements(), memoryIntent);
+        }
+        static VkMemoryAllocateInfo MemoryAllocateInfo(const VkMemoryRequirements& memoryRequirements, memoryTypeSelector::intent memoryIntent) {
+            VkMemoryAllocateInfo memoryAllocateInfo = {};
+            memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            memoryAllocateInfo.allocationSize = memoryRequirements.size;
+            memoryAllocateInfo.memoryTypeIndex = memoryTypeSelector::Get().MemoryTypeIndex(memoryRequirements.memoryTypeBits, memoryIntent);
+            return memoryAllocateInfo;
+        }
+        static VkMemoryAllocateInfo MemoryAllocateInfo(const VkMemoryRequirements& memoryRequirements, VkMemoryPropertyFlags desiredMemoryProperties) {
             VkMemoryAllocateInfo memoryAllocateInfo = {};
             memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-
-            VkMemoryRequirements memoryRequirements;
-            vkGetImageMemoryRequirements(graphicsBase::Base().Device(), handle, &memoryRequirements);
             memoryAllocateInfo.allocationSize = memoryRequirements.size;
             auto GetMemoryTypeIndex = [](uint32_t memoryTypeBits, VkMemoryPropertyFlags desiredMemoryProperties)->uint32_t {
                 auto& physicalDeviceMemoryProperties = graphicsBase::Base().PhysicalDeviceMemoryProperties();
@@ -1132,14 +1635,17 @@ namespace vulkan {
 
 //封装imageMemory类  -->包含image的创建与释放，内存由deviceMemory申请,然后绑定在一起
     class imageMemory :public image, public deviceMemory {
+        VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL; //用于决定子分配时放入线性还是非线性资源的内存块
     public:
-        imageMemory() = default;
+        imageMemory() { ObjectType(graphicsBase::memoryObject_imageMemory); }
         imageMemory(VkImageCreateInfo& createInfo, VkMemoryPropertyFlags desiredMemoryProperties) {
+            ObjectType(graphicsBase::memoryObject_imageMemory);
             Create(createInfo, desiredMemoryProperties);
         }
         imageMemory(imageMemory&& other) :
             image(std::move(other)), deviceMemory(std::move(other)) {
             areBound = other.areBound;
+            tiling = other.tiling;
             other.areBound = false;
         }
         ~imageMemory() { areBound = false; }
@@ -1151,30 +1657,56 @@ namespace vulkan {
         bool AreBound() const { return areBound; }
         using deviceMemory::AllocationSize;
         using deviceMemory::MemoryProperties;
+        using deviceMemory::MemoryOffset;
+        using deviceMemory::MemoryTypeIndex;
+        using deviceMemory::ObjectType;
         //Non-const Function
         //以下三个函数仅用于Create(...)可能执行失败的情况
         result_t CreateImage(VkImageCreateInfo& createInfo) {
+            tiling = createInfo.tiling;
             return image::Create(createInfo);
         }
-        result_t AllocateMemory(VkMemoryPropertyFlags desiredMemoryProperties) {
-            VkMemoryAllocateInfo allocateInfo = MemoryAllocateInfo(desiredMemoryProperties);
+        //dedicated为true时独占一块VkDeviceMemory，否则从deviceMemoryAllocator的内存块中子分配
+        result_t AllocateMemory(VkMemoryPropertyFlags desiredMemoryProperties, bool dedicated = false) {
+            VkMemoryRequirements memoryRequirements = MemoryRequirements();
+            VkMemoryAllocateInfo allocateInfo = MemoryAllocateInfo(memoryRequirements, desiredMemoryProperties);
             if (allocateInfo.memoryTypeIndex >= graphicsBase::Base().PhysicalDeviceMemoryProperties().memoryTypeCount)
                 return VK_RESULT_MAX_ENUM; //没有合适的错误代码，别用VK_ERROR_UNKNOWN
-            return Allocate(allocateInfo);
+            if (dedicated)
+                return Allocate(allocateInfo);
+            return Allocate(allocateInfo, memoryRequirements.alignment, tiling == VK_IMAGE_TILING_LINEAR);
+        }
+        //按用途选择内存类型，见memoryTypeSelector
+        result_t AllocateMemory(memoryTypeSelector::intent memoryIntent, bool dedicated = false) {
+            VkMemoryRequirements memoryRequirements = MemoryRequirements();
+            VkMemoryAllocateInfo allocateInfo = MemoryAllocateInfo(memoryRequirements, memoryIntent);
+            if (allocateInfo.memoryTypeIndex >= graphicsBase::Base().PhysicalDeviceMemoryProperties().memoryTypeCount)
+                return VK_RESULT_MAX_ENUM; //没有合适的错误代码，别用VK_ERROR_UNKNOWN
+            if (dedicated)
+                return Allocate(allocateInfo);
+            return Allocate(allocateInfo, memoryRequirements.alignment, tiling == VK_IMAGE_TILING_LINEAR);
         }
         result_t BindMemory() {
-            if (VkResult result = image::BindMemory(Memory())){
+            if (VkResult result = image::BindMemory(Memory(), MemoryOffset())){
                 return result;
             }
             areBound = true;
             return VK_SUCCESS;
         }
         //分配设备内存、创建图像、绑定
-        result_t Create(VkImageCreateInfo& createInfo, VkMemoryPropertyFlags desiredMemoryProperties) {
+        result_t Create(VkImageCreateInfo& createInfo, VkMemoryPropertyFlags desiredMemoryProperties, bool dedicated = false) {
             VkResult result;
             false || //这行用来应对Visual Studio中代码的对齐
                 (result = CreateImage(createInfo)) || //用||短路执行
-                (result = AllocateMemory(desiredMemoryProperties)) ||
+                (result = AllocateMemory(desiredMemoryProperties, dedicated)) ||
+                (result = BindMemory());
+            return result;
+        }
+        result_t Create(VkImageCreateInfo& createInfo, memoryTypeSelector::intent memoryIntent, bool dedicated = false) {
+            VkResult result;
+            false || //这行用来应对Visual Studio中代码的对齐
+                (result = CreateImage(createInfo)) || //用||短路执行
+                (result = AllocateMemory(memoryIntent, dedicated)) ||
                 (result = BindMemory());
             return result;
         }
@@ -1409,6 +1941,51 @@ namespace vulkan {
             return result;
         }
     };
+
+/*延迟销毁队列：按帧暂存待销毁的对象，等到GPU不再使用它们时再销毁，以免重建资源时WaitIdle()阻塞整个设备
+ * 1.Push(...)将RAII封装类对象（bufferMemory、imageMemory、imageView、pipeline等）移入当前帧的槽位，原对象变为空对象，可立刻重新创建
+ * 2.每帧等待了该帧的栅栏后调用NextFrame()，切换到下一个槽位并销毁其中的对象，这些对象是frameCount帧之前放入的
+ * 3.因此frameCount应不小于同时处理的帧数；逻辑设备销毁时（此前已WaitIdle()）销毁所有对象
+ * 4.frameContext在BeginFrame()中调用NextFrame()；不使用frameContext时须在等待了之前的提交后自行调用，否则对象直到graphicsBase::WaitIdle()才销毁
+ *
+ *  frame:     0        1        2(=0)
+ *  Push(A) -> [A]
+ *             NextFrame() -> [ ]
+ *                      NextFrame() -> 销毁A
+ */
+    class deferredDestructionQueue {
+        std::vector<std::vector<std::function<void()>>> frames = std::vector<std::vector<std::function<void()>>>(2);
+        uint32_t currentFrame = 0;
+        std::mutex mtx;
+        //--------------------
+        deferredDestructionQueue();
+        deferredDestructionQueue(deferredDestructionQueue&&) = delete;
+        ~deferredDestructionQueue() = default;
+    public:
+        static deferredDestructionQueue& Get() {
+            //同deviceMemoryAllocator，不随静态对象析构
+            static deferredDestructionQueue& singleton = *new deferredDestructionQueue;
+            return singleton;
+        }
+        //Getter
+        uint32_t FrameCount() const { return uint32_t(frames.size()); }
+        uint32_t CurrentFrame() const { return currentFrame; }
+        //Non-const Function
+        //该函数用于设置同时处理的帧数，被移除的槽位中的对象并入当前槽位，稍后销毁
+        void FrameCount(uint32_t frameCount);
+        //移入一个RAII封装类对象，object之后为空对象
+        template<typename T>
+        void Push(T& object) {
+            T* pObject = new T(std::move(object));
+            PushCallback([pObject] { delete pObject; });
+        }
+        //放入一个销毁用的函数，适用于没有RAII封装的handle
+        void PushCallback(std::function<void()> destroyer);
+        //该函数在等待了栅栏后调用，切换到下一帧并销毁该槽位中的对象
+        void NextFrame();
+        //该函数用于立刻销毁所有对象，调用前须确保GPU不再使用它们
+        void DestroyAll();
+    };
 }
 #endif // VKBASE_H
 
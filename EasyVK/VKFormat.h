@@ -9,6 +9,19 @@ struct formatInfo {
         integer,      //1，数据类型为整型
         floatingPoint //1，数据类型为浮点数
     };
+    //着色器读取时对数据的解释方式，由FormatNumeric(...)根据VK 1.0中格式的排列顺序得出
+    enum numeric :uint8_t {
+        unorm,
+        snorm,
+        uscaled,
+        sscaled,
+        uinteger,
+        sinteger,
+        srgb,
+        sfloat,
+        ufloat,
+        otherNumeric  //深度模板格式和压缩格式
+    };
     uint8_t componentCount;   //通道数
     uint8_t sizePerComponent; //每个通道的大小，0意味着压缩，或不均等，或少于1
     uint8_t sizePerPixel;     //每个像素的大小，0意味着压缩
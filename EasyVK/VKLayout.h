@@ -0,0 +1,188 @@
+#ifndef VKLAYOUT_H
+#define VKLAYOUT_H
+
+#include "EasyVKStart.h"
+
+//将elementCount个大小为elementSize、间隔为stride_src的元素拷贝到间隔为stride_dst的位置，不写入元素之间的空隙
+//常见的元素大小（1、2、4、8、12、16、32字节）为编译期定长的拷贝，两侧都紧密排列时等同于一次memcpy(...)
+//打包12字节（vec3）和16字节的元素用SSE2；32字节的元素及打包4/8字节的元素用AVX2（项目以-mavx2或/arch:AVX2编译）
+extern void CopyStridedElements(void* pData_dst, size_t stride_dst, const void* pData_src, size_t stride_src, size_t elementSize, size_t elementCount);
+
+/*编译期的std140/std430布局：描述一次uniform/storage块，在编译期算出各成员的偏移、数组步长和块的大小
+ * 1.标量的基础对齐为其大小；vec2为2倍标量，vec3和vec4为4倍标量；矩阵视作列向量的数组
+ * 2.数组的步长为元素大小向上凑整到元素的对齐，std140下数组和结构体的对齐还要向上凑整到16（vec4的对齐）
+ * 3.结构体的大小向上凑整到其对齐，因此结构体数组的步长即其大小
+ *
+ * 例：着色器中 layout(std430) buffer { particle particles[]; }，struct particle { vec3 position; float mass; vec2 velocity; };
+ *     struct particle { glm::vec3 position; float mass; glm::vec2 velocity; };
+ *     using particleLayout = glslStruct<std430, GlslMember(particle, position), GlslMember(particle, mass), GlslMember(particle, velocity)>;
+ *     particleLayout::size == 32, particleLayout::Offset(2) == 16
+ *     particleLayout::Pack(pData_dst, particles.data(), particles.size()); //布局与C++结构体一致时即一次memcpy(...)
+ */
+enum glslLayout :uint8_t {
+    std140,
+    std430
+};
+
+template<glslLayout Layout, typename... Members>
+struct glslStruct;
+
+//成员：CppT为C++中的类型，CppOffset为其在C++结构体中的偏移，GlslT为着色器中的类型（嵌套结构体时为glslStruct<...>）
+template<typename CppT, size_t CppOffset = 0, typename GlslT = CppT>
+struct glslMember {
+    using cppType = CppT;
+    using glslType = GlslT;
+    static constexpr size_t cppOffset = CppOffset;
+};
+#define GlslMember(Struct, member) glslMember<decltype(Struct::member), offsetof(Struct, member)>
+#define GlslMemberAs(Struct, member, GlslT) glslMember<decltype(Struct::member), offsetof(Struct, member), GlslT>
+
+constexpr VkDeviceSize GlslRoundUp(VkDeviceSize size, VkDeviceSize alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+/*glslTypeLayout<Layout, T>：类型T在着色器中的对齐、大小，以及与C++中大小为cppSize的同名类型是否逐字节相同
+ * 对每一种支持的T定义：
+ *  alignment、size
+ *  static constexpr bool IsCppCompatible(size_t cppSize)
+ *  static void Pack(uint8_t* pData_dst, size_t stride_dst, const uint8_t* pData_src, size_t stride_src, size_t cppSize, size_t count)
+ */
+template<glslLayout Layout, typename T, typename = void>
+struct glslTypeLayout;
+
+//标量和向量
+template<glslLayout Layout, typename T, VkDeviceSize ComponentCount>
+struct glslVectorLayout {
+    static constexpr VkDeviceSize alignment = sizeof(T) * (ComponentCount == 3 ? 4 : ComponentCount);
+    static constexpr VkDeviceSize size = sizeof(T) * ComponentCount;
+    static constexpr bool IsCppCompatible(size_t cppSize) { return cppSize == size; }
+    //C++中的类型较小时（如以GlslMemberAs(...)将glm::vec3声明为vec4）只拷贝cppSize个字节，其余分量写0；较大时只拷贝size个字节
+    static void Pack(uint8_t* pData_dst, size_t stride_dst, const uint8_t* pData_src, size_t stride_src, size_t cppSize, size_t count) {
+        size_t copySize = cppSize < size ? cppSize : size_t(size);
+        CopyStridedElements(pData_dst, stride_dst, pData_src, stride_src, copySize, count);
+        if (copySize < size)
+            for (size_t i = 0; i < count; i++)
+                memset(pData_dst + stride_dst * i + copySize, 0, size_t(size) - copySize);
+    }
+};
+template<glslLayout Layout, typename T>
+struct glslTypeLayout<Layout, T, typename std::enable_if<std::is_arithmetic<T>::value && sizeof(T) >= 4>::type> :
+    glslVectorLayout<Layout, T, 1> {};
+template<glslLayout Layout, glm::length_t L, typename T, glm::qualifier Q>
+struct glslTypeLayout<Layout, glm::vec<L, T, Q>> :
+    glslVectorLayout<Layout, T, L> {};
+
+//数组：std140下对齐和步长向上凑整到16
+template<glslLayout Layout, typename T, size_t N>
+struct glslArrayLayout {
+    using element = glslTypeLayout<Layout, T>;
+    static constexpr VkDeviceSize alignment = Layout == std140 ? GlslRoundUp(element::alignment, 16) : element::alignment;
+    static constexpr VkDeviceSize stride = GlslRoundUp(element::size, alignment);
+    static constexpr VkDeviceSize size = stride * N;
+    static constexpr bool IsCppCompatible(size_t cppSize) {
+        return cppSize % N == 0 && stride == cppSize / N && element::IsCppCompatible(cppSize / N);
+    }
+    static void Pack(uint8_t* pData_dst, size_t stride_dst, const uint8_t* pData_src, size_t stride_src, size_t cppSize, size_t count) {
+        //整个数组与C++一致时，每个结构体只需拷贝一次，否则每个下标拷贝一次
+        if (IsCppCompatible(cppSize))
+            return CopyStridedElements(pData_dst, stride_dst, pData_src, stride_src, cppSize, count);
+        for (size_t i = 0; i < N; i++)
+            element::Pack(pData_dst + stride * i, stride_dst, pData_src + cppSize / N * i, stride_src, cppSize / N, count);
+    }
+};
+template<glslLayout Layout, typename T, size_t N>
+struct glslTypeLayout<Layout, T[N]> :
+    glslArrayLayout<Layout, T, N> {};
+//矩阵：C个R维列向量的数组
+template<glslLayout Layout, glm::length_t C, glm::length_t R, typename T, glm::qualifier Q>
+struct glslTypeLayout<Layout, glm::mat<C, R, T, Q>> :
+    glslArrayLayout<Layout, glm::vec<R, T, Q>, C> {};
+
+//嵌套的结构体
+template<glslLayout Layout, glslLayout StructLayout, typename... Members>
+struct glslTypeLayout<Layout, glslStruct<StructLayout, Members...>> {
+    using type = glslStruct<StructLayout, Members...>;
+    static_assert(Layout == StructLayout, "A nested struct must use the layout of the enclosing block!");
+    static constexpr VkDeviceSize alignment = type::alignment;
+    static constexpr VkDeviceSize size = type::size;
+    static constexpr bool IsCppCompatible(size_t cppSize) { return type::IsCppCompatible(cppSize); }
+    static void Pack(uint8_t* pData_dst, size_t stride_dst, const uint8_t* pData_src, size_t stride_src, size_t cppSize, size_t count) {
+        type::PackStrided(pData_dst, stride_dst, pData_src, stride_src, cppSize, count);
+    }
+};
+
+//glslStruct的基类，在glslStruct的定义中计算对齐和大小时，其静态函数须已定义完毕
+template<glslLayout Layout, typename... Members>
+struct glslStructBase {
+    static_assert(sizeof...(Members), "A struct must have at least one member!");
+    static constexpr size_t memberCount = sizeof...(Members);
+protected:
+    template<typename Member>
+    using memberLayout = glslTypeLayout<Layout, typename Member::glslType>;
+    static constexpr VkDeviceSize MaxAlignment() {
+        const VkDeviceSize alignments[] = { memberLayout<Members>::alignment... };
+        VkDeviceSize result = 0;
+        for (VkDeviceSize i : alignments)
+            result = i > result ? i : result;
+        return result;
+    }
+    //成员index的偏移
+    static constexpr VkDeviceSize Begin(size_t index) {
+        const VkDeviceSize alignments[] = { memberLayout<Members>::alignment... };
+        const VkDeviceSize sizes[] = { memberLayout<Members>::size... };
+        VkDeviceSize end = 0;
+        for (size_t i = 0; i < index; i++)
+            end = GlslRoundUp(end, alignments[i]) + sizes[i];
+        return index < memberCount ? GlslRoundUp(end, alignments[index]) : end;
+    }
+};
+
+//块或结构体，成员按声明顺序排列
+template<glslLayout Layout, typename... Members>
+struct glslStruct :glslStructBase<Layout, Members...> {
+    using base = glslStructBase<Layout, Members...>;
+    using base::memberCount;
+    static constexpr VkDeviceSize alignment = Layout == std140 ? GlslRoundUp(base::MaxAlignment(), 16) : base::MaxAlignment();
+    //结构体的大小，也是结构体数组的步长
+    static constexpr VkDeviceSize size = GlslRoundUp(base::Begin(memberCount), alignment);
+
+    //Static Function
+    //成员index的偏移
+    static constexpr VkDeviceSize Offset(size_t index) {
+        return base::Begin(index);
+    }
+    //大小为cppSize的C++结构体是否与该布局逐字节相同（不计末尾的空隙）
+    static constexpr bool IsCppCompatible(size_t cppSize) {
+        const size_t cppOffsets[] = { Members::cppOffset... };
+        const bool compatibles[] = { base::template memberLayout<Members>::IsCppCompatible(sizeof(typename Members::cppType))... };
+        if (cppSize != size)
+            return false;
+        for (size_t i = 0; i < memberCount; i++)
+            if (cppOffsets[i] != Offset(i) || !compatibles[i])
+                return false;
+        return true;
+    }
+    //将count个C++结构体按该布局写入pData_dst，结构体之间的步长为size；每个成员一次CopyStridedElements(...)，不写入空隙
+    template<typename CppStruct>
+    static void Pack(void* pData_dst, const CppStruct* pData_src, size_t count) {
+        if (IsCppCompatible(sizeof(CppStruct)))
+            memcpy(pData_dst, pData_src, size_t(size) * count);
+        else
+            PackStrided(static_cast<uint8_t*>(pData_dst), size_t(size), reinterpret_cast<const uint8_t*>(pData_src), sizeof(CppStruct), sizeof(CppStruct), count);
+    }
+    static void PackStrided(uint8_t* pData_dst, size_t stride_dst, const uint8_t* pData_src, size_t stride_src, size_t cppSize, size_t count) {
+        PackMembers(pData_dst, stride_dst, pData_src, stride_src, count, std::make_index_sequence<memberCount>());
+    }
+private:
+    template<size_t... Indices>
+    static void PackMembers(uint8_t* pData_dst, size_t stride_dst, const uint8_t* pData_src, size_t stride_src, size_t count, std::index_sequence<Indices...>) {
+        int expander[] = {
+            (base::template memberLayout<Members>::Pack(pData_dst + Offset(Indices), stride_dst,
+                                                        pData_src + Members::cppOffset, stride_src,
+                                                        sizeof(typename Members::cppType), count), 0)...
+        };
+        (void)expander;
+    }
+};
+
+#endif // VKLAYOUT_H
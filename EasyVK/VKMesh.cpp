@@ -0,0 +1,297 @@
+#include "VKBase+.h"
+#include <glm/gtc/packing.hpp>
+
+//顶点的哈希值，顶点大小为4的倍数时按32位字计算
+static uint32_t HashVertex(const uint8_t* pVertex, size_t vertexStride) {
+    uint32_t hash = 2166136261u;
+    if (vertexStride % 4 == 0)
+        for (size_t i = 0; i < vertexStride; i += 4) {
+            uint32_t word;
+            memcpy(&word, pVertex + i, 4);
+            word *= 0x5bd1e995u;
+            word ^= word >> 24;
+            hash = (hash * 0x5bd1e995u) ^ (word * 0x5bd1e995u);
+        }
+    else
+        for (size_t i = 0; i < vertexStride; i++)
+            hash = (hash ^ pVertex[i]) * 16777619u;
+    return hash ^ hash >> 15;
+}
+
+uint32_t GenerateVertexRemap(uint32_t* pRemap, const uint32_t* pIndices, size_t indexCount, const void* pVertices, size_t vertexCount, size_t vertexStride, bool deduplicate) {
+    std::fill(pRemap, pRemap + vertexCount, UINT32_MAX);
+    //开放寻址的哈希表，存放每组相同顶点中首个被引用的顶点，容量为2的幂且不小于顶点数的2倍
+    std::vector<uint32_t> table;
+    size_t tableMask = 0;
+    if (deduplicate) {
+        size_t tableSize = 1;
+        while (tableSize < vertexCount * 2)
+            tableSize <<= 1;
+        table.assign(tableSize, UINT32_MAX);
+        tableMask = tableSize - 1;
+    }
+    const uint8_t* pData = static_cast<const uint8_t*>(pVertices);
+    uint32_t uniqueCount = 0;
+    for (size_t i = 0; i < indexCount; i++) {
+        uint32_t index = pIndices[i];
+        if (pRemap[index] != UINT32_MAX)
+            continue;
+        if (!deduplicate) {
+            pRemap[index] = uniqueCount++;
+            continue;
+        }
+        const uint8_t* pVertex = pData + vertexStride * index;
+        size_t slot = HashVertex(pVertex, vertexStride) & tableMask;
+        while (table[slot] != UINT32_MAX &&
+               memcmp(pData + vertexStride * table[slot], pVertex, vertexStride))
+            slot = (slot + 1) & tableMask;
+        if (table[slot] == UINT32_MAX)
+            table[slot] = index,
+            pRemap[index] = uniqueCount++;
+        else
+            pRemap[index] = pRemap[table[slot]];
+    }
+    return uniqueCount;
+}
+
+void RemapIndices(uint32_t* pIndices_dst, const uint32_t* pIndices_src, size_t indexCount, const uint32_t* pRemap) {
+    for (size_t i = 0; i < indexCount; i++)
+        pIndices_dst[i] = pRemap[pIndices_src[i]];
+}
+
+void RemapVertices(void* pVertices_dst, const void* pVertices_src, size_t vertexCount, size_t vertexStride, const uint32_t* pRemap) {
+    uint8_t* pDst = static_cast<uint8_t*>(pVertices_dst);
+    const uint8_t* pSrc = static_cast<const uint8_t*>(pVertices_src);
+    //去重后多个顶点映射到同一位置，内容相同，重复写入无妨
+    for (size_t i = 0; i < vertexCount; i++)
+        if (pRemap[i] != UINT32_MAX)
+            memcpy(pDst + vertexStride * pRemap[i], pSrc + vertexStride * i, vertexStride);
+}
+
+/*Tipsify：以某个顶点为扇心，输出其周围所有未输出的三角形，再从这些三角形的顶点中选出仍在缓存中、且剩余三角形不会将其挤出缓存的顶点作为下一个扇心
+ *  找不到时从死胡同栈（最近输出过的顶点）中取仍有剩余三角形的顶点，栈也空了则按编号顺序找下一个
+ *  时间复杂度与三角形数量成正比
+ */
+void OptimizeVertexCache(uint32_t* pIndices_dst, const uint32_t* pIndices_src, size_t indexCount, size_t vertexCount, uint32_t cacheSize) {
+    size_t triangleCount = indexCount / 3;
+    //每个顶点所在的三角形，CSR格式：顶点v的三角形为adjacency[offsets[v]]到adjacency[offsets[v + 1]]
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        offsets[pIndices_src[i] + 1]++;
+    for (size_t i = 0; i < vertexCount; i++)
+        offsets[i + 1] += offsets[i];
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    std::vector<uint32_t> liveCounts(vertexCount);
+    {
+        std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; i++)
+            adjacency[cursors[pIndices_src[i]]++] = uint32_t(i / 3);
+        for (size_t i = 0; i < vertexCount; i++)
+            liveCounts[i] = offsets[i + 1] - offsets[i];
+    }
+    std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnds;
+    std::vector<uint32_t> candidates;
+    uint32_t timestamp = cacheSize + 1;
+    size_t cursor = 0;      //按编号顺序查找时的位置
+    size_t outputCount = 0;
+    int64_t fanningVertex = triangleCount ? 0 : -1;
+    while (fanningVertex >= 0) {
+        candidates.clear();
+        for (uint32_t i = offsets[fanningVertex]; i < offsets[fanningVertex + 1]; i++) {
+            uint32_t triangle = adjacency[i];
+            if (emitted[triangle])
+                continue;
+            for (size_t j = 0; j < 3; j++) {
+                uint32_t vertex = pIndices_src[triangle * 3 + j];
+                pIndices_dst[outputCount++] = vertex;
+                deadEnds.push_back(vertex);
+                candidates.push_back(vertex);
+                liveCounts[vertex]--;
+                if (timestamp - cacheTimestamps[vertex] > cacheSize)
+                    cacheTimestamps[vertex] = timestamp++;
+            }
+            emitted[triangle] = true;
+        }
+        //选出下一个扇心：仍有剩余三角形，且输出它们后仍在缓存中的顶点里，在缓存中最久的那个
+        fanningVertex = -1;
+        uint32_t bestPriority = 0;
+        for (uint32_t vertex : candidates)
+            if (liveCounts[vertex]) {
+                uint32_t priority = 0;
+                if (timestamp - cacheTimestamps[vertex] + 2 * liveCounts[vertex] <= cacheSize)
+                    priority = timestamp - cacheTimestamps[vertex];
+                if (priority > bestPriority)
+                    bestPriority = priority,
+                    fanningVertex = vertex;
+            }
+        if (fanningVertex >= 0)
+            continue;
+        //死胡同
+        while (deadEnds.size() && fanningVertex < 0) {
+            uint32_t vertex = deadEnds.back();
+            deadEnds.pop_back();
+            if (liveCounts[vertex])
+                fanningVertex = vertex;
+        }
+        for (; cursor < vertexCount && fanningVertex < 0; cursor++)
+            if (liveCounts[cursor])
+                fanningVertex = cursor;
+    }
+}
+
+float AverageCacheMissRatio(const uint32_t* pIndices, size_t indexCount, size_t vertexCount, uint32_t cacheSize) {
+    if (indexCount < 3)
+        return 0;
+    //FIFO缓存：顶点在最近cacheSize次未命中之内进入缓存时命中
+    std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+    uint32_t timestamp = cacheSize + 1;
+    size_t missCount = 0;
+    for (size_t i = 0; i < indexCount; i++)
+        if (timestamp - cacheTimestamps[pIndices[i]] > cacheSize)
+            cacheTimestamps[pIndices[i]] = timestamp++,
+            missCount++;
+    return float(missCount) / float(indexCount / 3);
+}
+
+meshData OptimizeMesh(const void* pVertices, size_t vertexCount, size_t vertexStride, const uint32_t* pIndices, size_t indexCount, meshOptimizeFlags flags) {
+    meshData mesh;
+    mesh.vertexStride = vertexStride;
+    if (indexCount % 3)
+        qDebug("[ OptimizeMesh ] WARNING\nIndex count is not a multiple of 3, the trailing indices are dropped!\nIndex count: %llu\n", (unsigned long long)indexCount),
+        indexCount -= indexCount % 3;
+    for (size_t i = 0; i < indexCount; i++)
+        if (pIndices[i] >= vertexCount) {
+            qDebug("[ OptimizeMesh ] ERROR\nIndex out of range!\nIndex: %u\nVertex count: %llu\n", pIndices[i], (unsigned long long)vertexCount);
+            return mesh;
+        }
+    mesh.indices.assign(pIndices, pIndices + indexCount);
+    //1.顶点去重（同时丢弃未被引用的顶点）
+    std::vector<uint32_t> remap(vertexCount);
+    if (flags & MESH_OPTIMIZE_DEDUPLICATE_VERTICES) {
+        uint32_t uniqueCount = GenerateVertexRemap(remap.data(), mesh.indices.data(), indexCount, pVertices, vertexCount, vertexStride);
+        mesh.vertices.resize(vertexStride * uniqueCount);
+        RemapVertices(mesh.vertices.data(), pVertices, vertexCount, vertexStride, remap.data());
+        RemapIndices(mesh.indices.data(), mesh.indices.data(), indexCount, remap.data());
+    }
+    else
+        mesh.vertices.assign(static_cast<const uint8_t*>(pVertices), static_cast<const uint8_t*>(pVertices) + vertexStride * vertexCount);
+    //2.顶点缓存优化
+    if (flags & MESH_OPTIMIZE_VERTEX_CACHE) {
+        std::vector<uint32_t> indices_cacheOptimized(indexCount);
+        OptimizeVertexCache(indices_cacheOptimized.data(), mesh.indices.data(), indexCount, mesh.VertexCount());
+        mesh.indices.swap(indices_cacheOptimized);
+    }
+    //3.顶点读取优化，须在顶点缓存优化之后，按最终的索引顺序重排顶点
+    if (flags & MESH_OPTIMIZE_VERTEX_FETCH) {
+        uint32_t count = mesh.VertexCount();
+        uint32_t referencedCount = GenerateVertexRemap(remap.data(), mesh.indices.data(), indexCount, mesh.vertices.data(), count, vertexStride, false);
+        std::vector<uint8_t> vertices_fetchOptimized(vertexStride * referencedCount);
+        RemapVertices(vertices_fetchOptimized.data(), mesh.vertices.data(), count, vertexStride, remap.data());
+        RemapIndices(mesh.indices.data(), mesh.indices.data(), indexCount, remap.data());
+        mesh.vertices.swap(vertices_fetchOptimized);
+    }
+    return mesh;
+}
+
+//将一个分量量化为bitCount位，返回的值只有低bitCount位有效
+static uint32_t QuantizeComponent(float value, formatInfo::numeric numeric, uint32_t bitCount) {
+    uint32_t mask = bitCount == 32 ? UINT32_MAX : (1u << bitCount) - 1;
+    double max_unsigned = double(mask);
+    double max_signed = double(mask >> 1);
+    switch (numeric) {
+    case formatInfo::srgb:
+        value = glm::clamp(value, 0.f, 1.f);
+        value = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+        //不break，继续按UNORM量化
+        [[fallthrough]];
+    case formatInfo::unorm:
+        return uint32_t(std::round(glm::clamp(double(value), 0., 1.) * max_unsigned));
+    case formatInfo::snorm:
+        return uint32_t(int32_t(std::round(glm::clamp(double(value), -1., 1.) * max_signed))) & mask;
+    case formatInfo::uscaled:
+    case formatInfo::uinteger:
+        return uint32_t(glm::clamp(std::round(double(value)), 0., max_unsigned));
+    case formatInfo::sscaled:
+    case formatInfo::sinteger:
+        return uint32_t(int32_t(glm::clamp(std::round(double(value)), -max_signed - 1, max_signed))) & mask;
+    case formatInfo::sfloat:
+        if (bitCount == 16)
+            return glm::packHalf1x16(value);
+        uint32_t bits;
+        memcpy(&bits, &value, 4);
+        return bits;
+    default:
+        return 0;
+    }
+}
+
+bool vertexQuantizer::IsSupported(VkFormat format) {
+    if (format < VK_FORMAT_R8_UNORM || format > VK_FORMAT_R32G32B32A32_SFLOAT)
+        return false;
+    if (format >= VK_FORMAT_A2R10G10B10_UNORM_PACK32 && format <= VK_FORMAT_A2B10G10R10_SINT_PACK32)
+        return true;
+    uint32_t sizePerComponent = FormatInfo(format).sizePerComponent;
+    return sizePerComponent == 1 || sizePerComponent == 2 || sizePerComponent == 4;
+}
+
+vertexQuantizer& vertexQuantizer::Attribute(uint32_t location, VkFormat format, size_t offset_src, uint32_t componentCount_src) {
+    if (!IsSupported(format)) {
+        qDebug("[ vertexQuantizer ] ERROR\nUnsupported format for vertex quantization!\nLocation: %u\nFormat: %d\n", location, int32_t(format));
+        return *this;
+    }
+    if (!componentCount_src || componentCount_src > 4) {
+        qDebug("[ vertexQuantizer ] ERROR\nA source attribute must have 1 to 4 float components!\nLocation: %u\nComponent count: %u\n", location, componentCount_src);
+        return *this;
+    }
+    if (!(FormatProperties(format).bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT))
+        qDebug("[ vertexQuantizer ] WARNING\nThe physical device does not support the format as a vertex attribute!\nLocation: %u\nFormat: %d\n", location, int32_t(format));
+    formatInfo info = FormatInfo(format);
+    uint32_t attributeAlignment = info.sizePerComponent ? info.sizePerComponent : 4;
+    uint32_t offset_dst = uint32_t(GlslRoundUp(stride, attributeAlignment));
+    attributes.push_back({ location, format, uint32_t(offset_src), componentCount_src, offset_dst });
+    alignment = std::max(alignment, attributeAlignment);
+    stride = uint32_t(GlslRoundUp(offset_dst + info.sizePerPixel, alignment));
+    return *this;
+}
+
+void vertexQuantizer::Quantize(void* pData_dst, const void* pData_src, size_t stride_src, size_t vertexCount) const {
+    //多字节的分量按小端序写入
+    for (auto& i : attributes) {
+        formatInfo info = FormatInfo(i.format);
+        formatInfo::numeric numeric = FormatNumeric(i.format);
+        //B8G8R8(A8)和A2R10G10B10格式中，R与B分量的位置互换
+        bool swapRB =
+            (i.format >= VK_FORMAT_B8G8R8_UNORM && i.format <= VK_FORMAT_B8G8R8_SRGB) ||
+            (i.format >= VK_FORMAT_B8G8R8A8_UNORM && i.format <= VK_FORMAT_B8G8R8A8_SRGB) ||
+            (i.format >= VK_FORMAT_A2R10G10B10_UNORM_PACK32 && i.format <= VK_FORMAT_A2R10G10B10_SINT_PACK32);
+        const uint8_t* pSrc = static_cast<const uint8_t*>(pData_src) + i.offset_src;
+        uint8_t* pDst = static_cast<uint8_t*>(pData_dst) + i.offset_dst;
+        for (size_t j = 0; j < vertexCount; j++, pSrc += stride_src, pDst += stride) {
+            float components[4] = { 0, 0, 0, 1 };
+            memcpy(components, pSrc, sizeof(float) * i.componentCount_src);
+            if (swapRB)
+                std::swap(components[0], components[2]);
+            if (!info.sizePerComponent) {
+                //2_10_10_10：低位起依次为10位的R(B)、G、B(R)和2位的A
+                uint32_t packed = 0;
+                for (uint32_t k = 0; k < 4; k++)
+                    packed |= QuantizeComponent(components[k], numeric, k < 3 ? 10 : 2) << (k * 10);
+                memcpy(pDst, &packed, 4);
+                continue;
+            }
+            for (uint32_t k = 0; k < info.componentCount; k++) {
+                //SRGB格式的alpha分量是线性的
+                uint32_t bits = QuantizeComponent(components[k], numeric == formatInfo::srgb && k == 3 ? formatInfo::unorm : numeric, info.sizePerComponent * 8);
+                memcpy(pDst + info.sizePerComponent * k, &bits, info.sizePerComponent);
+            }
+        }
+    }
+}
+
+void vertexQuantizer::AddTo(graphicsPipelineCreateInfoPack& pipelineCiPack, VkVertexInputRate inputRate) const {
+    pipelineCiPack.vertexInputBindings.emplace_back(VkVertexInputBindingDescription{ binding, stride, inputRate });
+    for (auto& i : attributes)
+        pipelineCiPack.vertexInputAttributes.emplace_back(VkVertexInputAttributeDescription{ i.location, binding, i.format, i.offset_dst });
+}
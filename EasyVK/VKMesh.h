@@ -0,0 +1,105 @@
+#ifndef VKMESH_H
+#define VKMESH_H
+
+#include "EasyVKStart.h"
+
+/*网格优化：在上传顶点和索引前，于CPU端对三角形列表做预处理，减少顶点着色器的调用次数和显存带宽
+ * 1.顶点去重：逐字节相同的顶点合并为一个（-0.0f与0.0f视作不同），未被索引引用的顶点被丢弃
+ * 2.顶点缓存优化：重排三角形的顺序（Tipsify，Sander et al. 2007），使相邻三角形共享的顶点留在变换后的顶点缓存中
+ * 3.顶点读取优化：按在索引中首次出现的顺序重排顶点，使顶点着色器按顺序读取顶点缓冲区
+ * 4.所有索引都小于0xffff时，上传时可选用16位索引（0xffff留给primitive restart），见indexBuffer::TransferIndices(...)
+ *
+ *  三角形的顶点顺序（即朝向）不变，只改变三角形之间的顺序和顶点的编号
+ */
+enum meshOptimizeFlagBits :uint32_t {
+    MESH_OPTIMIZE_DEDUPLICATE_VERTICES = 0x1,
+    MESH_OPTIMIZE_VERTEX_CACHE = 0x2,
+    MESH_OPTIMIZE_VERTEX_FETCH = 0x4,
+    MESH_OPTIMIZE_ALL = 0x7
+};
+typedef uint32_t meshOptimizeFlags;
+
+//顶点缓存优化假定的缓存大小（顶点数），各厂商的GPU实际上不尽相同，16对大多数GPU都有不错的效果
+constexpr uint32_t defaultVertexCacheSize = 16;
+
+struct meshData {
+    std::vector<uint8_t> vertices;
+    std::vector<uint32_t> indices;
+    VkDeviceSize vertexStride = 0;
+    //Getter
+    uint32_t VertexCount() const { return vertexStride ? uint32_t(vertices.size() / vertexStride) : 0; }
+    uint32_t IndexCount() const { return uint32_t(indices.size()); }
+    //所有索引是否都能以16位索引表示
+    bool FitsUint16() const { return VertexCount() < 0xffff; }
+};
+
+//生成顶点的重映射表：pRemap[i]为顶点i的新编号，未被引用的顶点为UINT32_MAX，新编号按首次被引用的顺序分配，返回不重复的顶点数
+//deduplicate为false时只丢弃未被引用的顶点
+uint32_t GenerateVertexRemap(uint32_t* pRemap, const uint32_t* pIndices, size_t indexCount, const void* pVertices, size_t vertexCount, size_t vertexStride, bool deduplicate = true);
+//按重映射表改写索引，pIndices_dst可以与pIndices_src相同
+void RemapIndices(uint32_t* pIndices_dst, const uint32_t* pIndices_src, size_t indexCount, const uint32_t* pRemap);
+//按重映射表将顶点写入新编号的位置，pVertices_dst不能与pVertices_src相同
+void RemapVertices(void* pVertices_dst, const void* pVertices_src, size_t vertexCount, size_t vertexStride, const uint32_t* pRemap);
+//重排三角形以提高顶点缓存的命中率，pIndices_dst不能与pIndices_src相同
+void OptimizeVertexCache(uint32_t* pIndices_dst, const uint32_t* pIndices_src, size_t indexCount, size_t vertexCount, uint32_t cacheSize = defaultVertexCacheSize);
+//模拟大小为cacheSize的FIFO顶点缓存，返回平均每个三角形的缓存未命中次数（ACMR，范围为0.5~3，越小越好）
+float AverageCacheMissRatio(const uint32_t* pIndices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = defaultVertexCacheSize);
+
+//依次执行flags中的各项优化，返回优化后的网格，索引数量须为3的倍数（三角形列表）
+meshData OptimizeMesh(const void* pVertices, size_t vertexCount, size_t vertexStride, const uint32_t* pIndices, size_t indexCount, meshOptimizeFlags flags = MESH_OPTIMIZE_ALL);
+
+struct graphicsPipelineCreateInfoPack;
+
+/*顶点属性的量化：上传时将C++结构体中的float属性转为更小的格式，降低顶点读取的带宽，着色器中仍以float/vec读取
+ * 格式的分量数和大小取自formatInfos_v1_0，支持VK 1.0中分量为8/16/32位的格式及2_10_10_10打包格式
+ * 1.UNORM/SNORM：截断到[0, 1]/[-1, 1]，乘以最大值后四舍五入；SRGB格式的RGB分量先做sRGB编码
+ * 2.USCALED/SSCALED/UINT/SINT：四舍五入并截断到可表示的范围
+ * 3.SFLOAT：16位即半精度浮点数
+ * 源属性的分量少于格式的分量时，缺少的分量补0，第4个分量补1；多于格式的分量时，多余的分量被丢弃
+ * 各属性在量化后的顶点中按添加顺序排列，偏移对齐到分量的大小（打包格式为4），Stride()为其中最大的对齐的倍数
+ *
+ * 例：struct vertex { glm::vec2 position; glm::vec4 color; };  24字节
+ *     vertexQuantizer quantizer;
+ *     quantizer.Attribute(0, VK_FORMAT_R16G16_SNORM, offsetof(vertex, position), 2)
+ *              .Attribute(1, VK_FORMAT_R8G8B8A8_UNORM, offsetof(vertex, color), 4); //Stride() == 8
+ *     quantizer.AddTo(pipelineCiPack);                                                //创建管线时
+ *     vertexBuffer.TransferQuantized(quantizer, vertices.data(), sizeof(vertex), vertexCount);
+ */
+class vertexQuantizer {
+    struct attribute {
+        uint32_t location;
+        VkFormat format;
+        uint32_t offset_src;
+        uint32_t componentCount_src;
+        uint32_t offset_dst;
+    };
+    std::vector<attribute> attributes;
+    uint32_t binding = 0;
+    uint32_t stride = 0;
+    uint32_t alignment = 1;
+public:
+    vertexQuantizer(uint32_t binding = 0) :binding(binding) {}
+    //Getter
+    uint32_t Binding() const { return binding; }
+    //量化后每个顶点的大小
+    uint32_t Stride() const { return stride; }
+    //Const Function
+    //将vertexCount个间隔为stride_src的顶点量化后写入pData_dst，写入的大小为Stride() * vertexCount
+    void Quantize(void* pData_dst, const void* pData_src, size_t stride_src, size_t vertexCount) const;
+    std::vector<uint8_t> Quantize(const void* pData_src, size_t stride_src, size_t vertexCount) const {
+        std::vector<uint8_t> data(size_t(stride) * vertexCount);
+        Quantize(data.data(), pData_src, stride_src, vertexCount);
+        return data;
+    }
+    //向管线创建信息中添加对应的顶点绑定和属性描述，之后须调用pipelineCiPack.UpdateAllArrays()
+    void AddTo(graphicsPipelineCreateInfoPack& pipelineCiPack, VkVertexInputRate inputRate = VK_VERTEX_INPUT_RATE_VERTEX) const;
+    //Non-const Function
+    //添加一个属性，源数据为位于offset_src处的componentCount_src个float；格式不支持时报错并忽略该属性
+    vertexQuantizer& Attribute(uint32_t location, VkFormat format, size_t offset_src, uint32_t componentCount_src);
+
+    //Static Function
+    //能否量化到该格式（不检查物理设备是否支持将其用作顶点属性）
+    static bool IsSupported(VkFormat format);
+};
+
+#endif // VKMESH_H
@@ -46,6 +46,14 @@ struct vertex {
     glm::vec4 color;
 };
 
+//上传时将position量化为R16G16_SNORM、color量化为R8G8B8A8_UNORM，每个顶点由24字节减为8字节，着色器不需要修改
+const vertexQuantizer& VertexQuantizer() {
+    static const vertexQuantizer quantizer = vertexQuantizer(0)
+        .Attribute(0, VK_FORMAT_R16G16_SNORM, offsetof(vertex, position), 2)
+        .Attribute(1, VK_FORMAT_R8G8B8A8_UNORM, offsetof(vertex, color), 4);
+    return quantizer;
+}
+
 const easyVulkan::renderPassWithFramebuffers& RenderPassAndFramebuffers() {
     static const auto& rpwf = easyVulkan::CreateRpwf_Screen();
     return rpwf;
@@ -114,11 +122,8 @@ void CreatePipeline() {
         pipelineCiPack.createInfo.renderPass = RenderPassAndFramebuffers().renderPass;
 
         //数据来自0号顶点缓冲区，输入频率是逐顶点输入
-        pipelineCiPack.vertexInputBindings.emplace_back(VkVertexInputBindingDescription{0, sizeof(vertex), VK_VERTEX_INPUT_RATE_VERTEX});
-        //location为0，数据来自0号顶点缓冲区，vec2对应VK_FORMAT_R32G32_SFLOAT，用offsetof计算position在vertex中的起始位置
-        pipelineCiPack.vertexInputAttributes.emplace_back(VkVertexInputAttributeDescription{0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(vertex, position)});
-        //location为1，数据来自0号顶点缓冲区，vec4对应VK_FORMAT_R32G32B32A32_SFLOAT，用offsetof计算color在vertex中的起始位置
-        pipelineCiPack.vertexInputAttributes.emplace_back(VkVertexInputAttributeDescription{1, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(vertex, color)});
+        //location为0的position和location为1的color的格式和偏移由VertexQuantizer()给出，而非vertex中的float和offsetof
+        VertexQuantizer().AddTo(pipelineCiPack);
 
         //数据来自1号顶点缓冲区，输入频率是逐实例输入
         pipelineCiPack.vertexInputBindings.emplace_back(VkVertexInputBindingDescription
@@ -191,17 +196,6 @@ int main_076(int argc, char *argv[])
     CreateLayout();
     CreatePipeline();
 
-    //以置位状态创建栅栏
-    vulkan::fence fence(VK_FENCE_CREATE_SIGNALED_BIT);
-
-    //创建二值信号量
-    semaphore semaphore_imageIsAvailable;
-    semaphore semaphore_renderingIsOver;
-
-    vulkan::commandBuffer commandBuffer;
-    commandPool commandPool(graphicsBase::Base().QueueFamilyIndex_Graphics(), VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
-    commandPool.AllocateBuffers(commandBuffer);
-
     VkClearValue clearColor = {};
     clearColor.color = { 0.0f, 0.5f, 1.f, 1.f };
 
@@ -210,8 +204,8 @@ int main_076(int argc, char *argv[])
         { { -.5f,  .5f }, { 0, 1, 0, 1 } },
         { {  .5f,  .5f }, { 0, 0, 1, 1 } }
     };
-    vertexBuffer vertexBuffer_perVertex(vertices.size() * sizeof(vertex));
-    vertexBuffer_perVertex.TransferData(vertices.data(),vertices.size() * sizeof(vertex));
+    vertexBuffer vertexBuffer_perVertex(vertices.size() * VertexQuantizer().Stride());
+    vertexBuffer_perVertex.TransferQuantized(VertexQuantizer(), vertices.data(), sizeof(vertex), uint32_t(vertices.size()));
 
     //创建描述符池
     VkDescriptorPoolSize descriptorPoolSizes[] =
@@ -225,49 +219,31 @@ int main_076(int argc, char *argv[])
     descriptor_pool.AllocateSets(descriptorSet_trianglePosition,descriptorSetLayout_triangle);
 
     //uniform缓冲区的信息写入描述符. 注意:uniform buffer 遵循std140 标准，uniform block步长为16. vec2 = 8  2*vec2 => vec4
-    std::vector<glm::vec4> uniform_positions = {
-        glm::vec4( 0.0f, 0.0f,0,0),
-        glm::vec4(-0.5f, 0.0f,0,0),
-        glm::vec4( 0.5f, 0.0f,0,0),
+    //std140下的大小和偏移由trianglePosition在编译期算出，C++端只需保存vec2，不必手动补成vec4（着色器只读取xy）
+    using trianglePosition = glslStruct<std140, glslMember<glm::vec2>>;
+    std::vector<glm::vec2> uniform_positions = {
+        glm::vec2( 0.0f, 0.0f),
+        glm::vec2(-0.5f, 0.0f),
+        glm::vec2( 0.5f, 0.0f),
     };
 
-    //每组数据的大小向上凑整到单位对齐距离的整数倍并相加，得到整个缓冲区的大小
-    //VkDeviceSize uniformBufferSize = uniformAlignment * (std::ceil(float(dataSize[0]) / uniformAlignment) + ... + std::ceil(float(dataSize[2]) / uniformAlignment));
-
-    VkDeviceSize uniformAlignment = graphicsBase::Base().PhysicalDeviceProperties().limits.minUniformBufferOffsetAlignment;
-    uniformAlignment *= (std::ceil(float(sizeof(glm::vec4)) / uniformAlignment));
-
-
-    uniformBuffer uniform_buffer(uniform_positions.size() * uniformAlignment);
-    uniform_buffer.TransferData(uniform_positions.data(),
-                                uniform_positions.size(),
-                                sizeof(glm::vec4),
-                                sizeof(glm::vec4),
-                                uniformAlignment);
-
-    VkDescriptorBufferInfo ubufferInfo = {};
-    ubufferInfo.buffer = uniform_buffer;
-    ubufferInfo.offset = 0;
-    ubufferInfo.range = sizeof(glm::vec4);
-    descriptorSet_trianglePosition.write(ubufferInfo,VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,0);
-
-    while (!glfwWindowShouldClose(pWindow)) {
-        //窗口最小化时停止渲染循环
-        while (glfwGetWindowAttrib(pWindow, GLFW_ICONIFIED)){
-            glfwWaitEvents();
-        }
-
-        //重置栅栏
-        fence.Reset();
-
-        //获取交换链图像索引
-        graphicsBase::Base().SwapImage(semaphore_imageIsAvailable);
-        auto imageIndex = graphicsBase::Base().CurrentImageIndex();
-
+    //三角形的位置不变：一次写入uniform缓冲区，每组数据的大小向上凑整到单位对齐距离的整数倍，dynamic offset固定不变
+    //录制的命令中不含每帧变化的数据，因此可以为每张交换链图像录制一次后重复提交
+    VkDeviceSize uniformAlignedSize = uniformBuffer::CalculateAlignedSize(trianglePosition::size);
+    uniformBuffer uniformBuffer_trianglePosition(uniform_positions.size() * uniformAlignedSize);
+    std::vector<uint8_t> uniformData(size_t(uniformBuffer_trianglePosition.Size()));
+    std::vector<uint32_t> dynamicOffsets(uniform_positions.size());
+    for(size_t ubo_idx = 0; ubo_idx < uniform_positions.size();ubo_idx++){
+        dynamicOffsets[ubo_idx] = uint32_t(uniformAlignedSize * ubo_idx);
+        trianglePosition::Pack(uniformData.data() + dynamicOffsets[ubo_idx], &uniform_positions[ubo_idx], 1);
+    }
+    uniformBuffer_trianglePosition.TransferData(uniformData.data(), uniformData.size());
 
-        //开始录制命令
-        commandBuffer.Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    VkDescriptorBufferInfo ubufferInfo = { uniformBuffer_trianglePosition, 0, trianglePosition::size };
+    descriptorSet_trianglePosition.write(ubufferInfo,VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,0);
 
+    //录制一帧的命令，imageIndex为交换链图像索引
+    auto Record = [&](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
         //开始渲染通道
         rpwf.renderPass.CmdBegin(commandBuffer, rpwf.framebuffers[imageIndex], { {}, windowSize }, clearColor);
 
@@ -278,7 +254,6 @@ int main_076(int argc, char *argv[])
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_triangle);
         //绑定描述符并绘制
         for(size_t ubo_idx = 0; ubo_idx < uniform_positions.size();ubo_idx++){
-            uint32_t dynamicOffset = uniformAlignment * ubo_idx;
             vkCmdBindDescriptorSets(commandBuffer,
                                     VK_PIPELINE_BIND_POINT_GRAPHICS,
                                     pipelineLayout_triangle,
@@ -286,30 +261,380 @@ int main_076(int argc, char *argv[])
                                     1,
                                     descriptorSet_trianglePosition.Address(),
                                     1,
-                                    &dynamicOffset);
+                                    &dynamicOffsets[ubo_idx]);
 
             vkCmdDraw(commandBuffer, 3, 1, 0, 0);
         }
 
-
         //结束渲染通道
         rpwf.renderPass.CmdEnd(commandBuffer);
+    };
 
-        //结束录制命令
-        commandBuffer.End();
+    //同时处理2帧：每帧有各自的命令池、命令缓冲区、栅栏和信号量，CPU录制下一帧时不必等待GPU执行完当前帧
+    frameContext frames(2);
+    //预录制的命令缓冲区：每张交换链图像录制一次，交换链重建时自动重新录制；管线、描述符等改变时须调用Invalidate()
+    recordedCommandBuffers recorded(Record);
 
-        //提交命令缓冲
-        graphicsBase::Base().SubmitCommandBuffer_Graphics(commandBuffer, semaphore_imageIsAvailable, semaphore_renderingIsOver, fence);
+    //每600帧在“预录制后重复使用”和“每帧重新录制”之间切换，输出平均每帧取得命令缓冲区的CPU耗时
+    using clock = std::chrono::steady_clock;
+    uint32_t frameCount = 0;
+    double recordingTime = 0;
+    while (!glfwWindowShouldClose(pWindow)) {
+        //窗口最小化时停止渲染循环
+        while (glfwGetWindowAttrib(pWindow, GLFW_ICONIFIED)){
+            glfwWaitEvents();
+        }
 
-        //呈现图像
-        graphicsBase::Base().PresentImage(semaphore_renderingIsOver);
+        //等待frameCount帧之前使用同一套资源的提交执行完毕，重置该帧的命令池，获取交换链图像索引
+        if (frames.BeginFrame())
+            continue;
+        auto imageIndex = graphicsBase::Base().CurrentImageIndex();
 
+        bool reuse = frameCount / 600 % 2 == 0;
+        auto t0 = clock::now();
+        VkCommandBuffer commandBuffer = (VkCommandBuffer)VK_NULL_HANDLE;
+        if (reuse)
+            commandBuffer = recorded.CommandBuffer(imageIndex);
+        else {
+            const vulkan::commandBuffer& commandBuffer_frame = frames.CommandBuffer();
+            commandBuffer_frame.Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+            Record(commandBuffer_frame, imageIndex);
+            commandBuffer_frame.End();
+            commandBuffer = commandBuffer_frame;
+        }
+        recordingTime += std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+        //预录制失败（错误信息已输出），不提交空的命令缓冲区
+        if (!commandBuffer)
+            break;
+
+        //提交命令缓冲并呈现图像，不等待GPU执行完毕，切换到下一帧
+        frames.EndFrame(commandBuffer);
+
+        if (++frameCount % 600 == 0)
+            qDebug("%s: %.4f ms per frame | recorded %u time(s) in total\n",
+                   reuse ? "pre-recorded" : "re-recorded ", recordingTime / 600, recorded.RecordCount()),
+            recordingTime = 0;
         glfwPollEvents();
         TitleFps();
+    }
+    TerminateWindow();
 
-        //等待并重置fence
-        fence.WaitAndReset();
+    a.quit();
+    return 0;
+}
+
+
+//并行录制：与main_076相同的三角形，每帧绘制drawCount次，由parallelRecorder分给多个工作线程录制次级命令缓冲区
+//每600帧在单线程和多线程的parallelRecorder间切换，输出平均每帧的录制耗时
+int main_parallel_recording(int argc, char *argv[])
+{
+    QCoreApplication a(argc,argv);
+
+    //set vulkan env
+    setupVulkanEnv();
+
+    if (!InitializeWindow({ 640, 480 }))
+        return -1;
+
+    const auto& rpwf = RenderPassAndFramebuffers();
+
+    CreateLayout();
+    CreatePipeline();
+
+    std::vector<vertex> vertices = {
+        { {  .0f, -.5f }, { 1, 0, 0, 1 } },
+        { { -.5f,  .5f }, { 0, 1, 0, 1 } },
+        { {  .5f,  .5f }, { 0, 0, 1, 1 } }
+    };
+    vertexBuffer vertexBuffer_perVertex(vertices.size() * VertexQuantizer().Stride());
+    vertexBuffer_perVertex.TransferQuantized(VertexQuantizer(), vertices.data(), sizeof(vertex), uint32_t(vertices.size()));
+
+    VkDescriptorPoolSize descriptorPoolSizes[] = {
+        VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 },
+    };
+    descriptorPool descriptor_pool(1, descriptorPoolSizes);
+    descriptorSet descriptorSet_trianglePosition;
+    descriptor_pool.AllocateSets(descriptorSet_trianglePosition, descriptorSetLayout_triangle);
+
+    using trianglePosition = glslStruct<std140, glslMember<glm::vec2>>;
+    std::vector<glm::vec2> uniform_positions = {
+        glm::vec2( 0.0f, 0.0f),
+        glm::vec2(-0.5f, 0.0f),
+        glm::vec2( 0.5f, 0.0f),
+    };
+    frameContext frames(2, uniform_positions.size() * uniformBuffer::CalculateAlignedSize(trianglePosition::size));
+    uniformRingBuffer& uniform_ring = frames.TransientUniforms();
+    std::vector<uint32_t> dynamicOffsets(uniform_positions.size());
+    descriptorSet_trianglePosition.write(uniform_ring.DescriptorBufferInfo(trianglePosition::size), VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0);
+
+    //工作线程的帧数须与frameContext相同
+    parallelRecorder recorders[] = { { 1, frames.FrameCount() }, { 0, frames.FrameCount() } };
+    const uint32_t drawCount = 50000;
+    //每段自行绑定管线、顶点缓冲区和描述符集，次级命令缓冲区不继承主命令缓冲区的绑定
+    parallelRecorder::record_t record = [&](VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end, uint32_t /*workerIndex*/) {
+        VkDeviceSize offset = 0;
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_triangle);
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffer_perVertex.Address(), &offset);
+        for (uint32_t i = begin; i < end; i++) {
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout_triangle, 0, 1,
+                                    descriptorSet_trianglePosition.Address(), 1, &dynamicOffsets[i % dynamicOffsets.size()]);
+            vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+        }
+    };
+
+    VkClearValue clearColor = {};
+    clearColor.color = { 0.0f, 0.5f, 1.f, 1.f };
+    using clock = std::chrono::steady_clock;
+    uint32_t frameCount = 0;
+    double recordingTime = 0;
+    while (!glfwWindowShouldClose(pWindow)) {
+        while (glfwGetWindowAttrib(pWindow, GLFW_ICONIFIED)){
+            glfwWaitEvents();
+        }
+        if (frames.BeginFrame())
+            continue;
+        parallelRecorder& recorder = recorders[frameCount / 600 % 2];
+        recorder.BeginFrame(frames.CurrentFrame());
+        auto imageIndex = graphicsBase::Base().CurrentImageIndex();
+        const vulkan::commandBuffer& commandBuffer = frames.CommandBuffer();
+
+        for (size_t i = 0; i < uniform_positions.size(); i++)
+            dynamicOffsets[i] = uniform_ring.PushPacked<trianglePosition>(&uniform_positions[i]);
+
+        commandBuffer.Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        //该子通道的内容全部来自次级命令缓冲区
+        rpwf.renderPass.CmdBegin(commandBuffer, rpwf.framebuffers[imageIndex], { {}, windowSize }, clearColor, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        auto t0 = clock::now();
+        recorder.CmdExecuteParallel(commandBuffer, rpwf.renderPass, 0, rpwf.framebuffers[imageIndex], drawCount, record);
+        recordingTime += std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+        rpwf.renderPass.CmdEnd(commandBuffer);
+        commandBuffer.End();
+
+        frames.EndFrame();
+
+        if (++frameCount % 600 == 0)
+            qDebug("%u draws | %2u worker(s) | recording: %.3f ms per frame\n", drawCount, recorder.WorkerCount(), recordingTime / 600),
+            recordingTime = 0;
+        glfwPollEvents();
+        TitleFps();
+    }
+    TerminateWindow();
+
+    a.quit();
+    return 0;
+}
+
+//多线程提交的压力测试：threadCount个线程同时向图形、计算、传输队列提交（这些用途常为同一VkQueue），主线程同时渲染、呈现并不时调用WaitIdle()
+//每次提交以vkCmdFillBuffer(...)将该线程的缓冲区写为本次的序号，等待栅栏后读回校验；去掉graphicsBase中的队列锁时，验证层会报告对VkQueue的并发访问
+int main_stress_queue_submission(int argc, char *argv[])
+{
+    QCoreApplication a(argc,argv);
+
+    //set vulkan env
+    setupVulkanEnv();
+
+    if (!InitializeWindow({ 640, 480 }))
+        return -1;
+
+    const auto& rpwf = RenderPassAndFramebuffers();
+    graphicsBase& base = graphicsBase::Base();
+
+    enum queueType { graphics, compute, transfer };
+    struct worker {
+        queueType queue;
+        commandPool command_pool;
+        commandBuffer command_buffer;
+        fence fence_submitted;
+        bufferMemory buffer_memory;
+        uint32_t submitCount = 0;
+        uint32_t mismatchCount = 0;
+        uint32_t failureCount = 0;
+    };
+    const uint32_t threadCount = std::max(std::thread::hardware_concurrency(), 4u);
+    const uint32_t submitCountPerThread = 2000;
+    const VkDeviceSize bufferSize = 256;
+    //各线程轮流使用图形、计算、传输队列，没有计算队列时用图形队列代替；缓冲区和命令池都在主线程中创建
+    std::vector<std::unique_ptr<worker>> workers;
+    VkBufferCreateInfo bufferCreateInfo = {};
+    bufferCreateInfo.size = bufferSize;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    for (uint32_t i = 0; i < threadCount; i++) {
+        workers.push_back(std::make_unique<worker>());
+        worker& worker_new = *workers.back();
+        worker_new.queue = queueType(i % 3);
+        if (worker_new.queue == compute && !base.Queue_Compute())
+            worker_new.queue = graphics;
+        uint32_t queueFamilyIndices[] = { base.QueueFamilyIndex_Graphics(), base.QueueFamilyIndex_Compute(), base.QueueFamilyIndex_Transfer() };
+        worker_new.command_pool.Create(queueFamilyIndices[worker_new.queue], VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+        worker_new.command_pool.AllocateBuffers(worker_new.command_buffer);
+        worker_new.buffer_memory.Create(bufferCreateInfo, memoryTypeSelector::readback);
+    }
+
+    std::atomic<uint32_t> finishedCount(0);
+    auto Work = [&](worker& worker_current) {
+        std::vector<uint32_t> values(size_t(bufferSize / 4));
+        for (uint32_t n = 1; n <= submitCountPerThread; n++) {
+            worker_current.command_buffer.Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+            vkCmdFillBuffer(worker_current.command_buffer, worker_current.buffer_memory.Buffer(), 0, bufferSize, n);
+            //使写入的数据对CPU可见
+            VkBufferMemoryBarrier bufferMemoryBarrier = {
+                VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                nullptr,
+                VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_ACCESS_HOST_READ_BIT,
+                VK_QUEUE_FAMILY_IGNORED,
+                VK_QUEUE_FAMILY_IGNORED,
+                worker_current.buffer_memory.Buffer(),
+                0,
+                bufferSize
+            };
+            vkCmdPipelineBarrier(worker_current.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                0, nullptr, 1, &bufferMemoryBarrier, 0, nullptr);
+            worker_current.command_buffer.End();
+            VkResult result = VK_SUCCESS;
+            switch (worker_current.queue) {
+            case graphics: result = base.SubmitCommandBuffer_Graphics(worker_current.command_buffer, worker_current.fence_submitted); break;
+            case compute: result = base.SubmitCommandBuffer_Compute(worker_current.command_buffer, worker_current.fence_submitted); break;
+            case transfer: result = base.SubmitCommandBuffer_Transfer(worker_current.command_buffer, (VkSemaphore)VK_NULL_HANDLE, worker_current.fence_submitted); break;
+            }
+            //提交失败时栅栏不会被置位，不再继续
+            if (result || worker_current.fence_submitted.Wait() || worker_current.fence_submitted.Reset()) {
+                worker_current.failureCount++;
+                break;
+            }
+            worker_current.buffer_memory.RetrieveData(values.data(), bufferSize);
+            for (uint32_t value : values)
+                if (value != n) {
+                    worker_current.mismatchCount++;
+                    break;
+                }
+            worker_current.submitCount++;
+        }
+        finishedCount++;
+    };
+
+    using clock = std::chrono::steady_clock;
+    auto t0 = clock::now();
+    std::vector<std::thread> threads;
+    for (auto& i : workers)
+        threads.emplace_back(Work, std::ref(*i));
+
+    //主线程同时渲染和呈现，每64帧调用一次WaitIdle()（锁住所有队列）
+    VkClearValue clearColor = {};
+    clearColor.color = { 0.0f, 0.5f, 1.f, 1.f };
+    frameContext frames(2);
+    uint32_t frameCount = 0;
+    while (finishedCount < threadCount && !glfwWindowShouldClose(pWindow)) {
+        glfwPollEvents();
+        if (glfwGetWindowAttrib(pWindow, GLFW_ICONIFIED) || frames.BeginFrame())
+            continue;
+        const commandBuffer& command_buffer = frames.CommandBuffer();
+        command_buffer.Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        rpwf.renderPass.CmdBegin(command_buffer, rpwf.framebuffers[base.CurrentImageIndex()], { {}, windowSize }, clearColor);
+        rpwf.renderPass.CmdEnd(command_buffer);
+        command_buffer.End();
+        frames.EndFrame();
+        if (++frameCount % 64 == 0)
+            base.WaitIdle();
+    }
+    for (auto& i : threads)
+        i.join();
+    double seconds = std::chrono::duration<double>(clock::now() - t0).count();
+
+    uint32_t submitCounts[3] = {}, mismatchCount = 0, failureCount = 0;
+    for (auto& i : workers)
+        submitCounts[i->queue] += i->submitCount,
+        mismatchCount += i->mismatchCount,
+        failureCount += i->failureCount;
+    uint32_t submitCount = submitCounts[graphics] + submitCounts[compute] + submitCounts[transfer];
+    qDebug("%u threads | submits: %u (graphics %u, compute %u, transfer %u), %.0f per second | frames: %u | mismatches: %u | failures: %u\n",
+           threadCount, submitCount, submitCounts[graphics], submitCounts[compute], submitCounts[transfer], submitCount / seconds,
+           frameCount, mismatchCount, failureCount);
+    TerminateWindow();
+
+    a.quit();
+    return 0;
+}
+
+//strided TransferData(...)的基准测试：每个元素一个拷贝区域的旧路径 vs 打包后一个拷贝区域
+int main_benchmark_strided_transfer(int argc, char *argv[])
+{
+    QCoreApplication a(argc,argv);
+
+    //set vulkan env
+    setupVulkanEnv();
+
+    if (!InitializeWindow({ 640, 480 }))
+        return -1;
 
+    //从交错排列的顶点数据中取出位置，源间隔32字节，元素12字节
+    struct vertex_interleaved {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec2 texCoord;
+    };
+    const uint32_t elementCounts[] = { 10000, 100000, 1000000 };
+    const uint32_t repeatCount = 20;
+    //打包后的数据量不超过uploadBatch的块大小，新路径才会经由主线程暂存缓冲区，与旧路径使用同一暂存区和同一队列
+    //以足够大的容量重新创建本线程的stagingRing，使块大小能容纳最大的一组（1M个vec3，12MB）
+    stagingRing::ReleaseThisThread();
+    stagingRing::ThisThread(sizeof(glm::vec3) * elementCounts[2] * uploadBatch::chunkCount);
+    const uint32_t maxElementCount = uint32_t(stagingRing::ThisThread().Capacity() / uploadBatch::chunkCount / sizeof(glm::vec3));
+    std::vector<vertex_interleaved> vertices(elementCounts[2]);
+    for (size_t i = 0; i < vertices.size(); i++)
+        vertices[i].position = glm::vec3(float(i), float(i) * 0.5f, float(i) * 0.25f);
+
+    using clock = std::chrono::steady_clock;
+    for (uint32_t elementCount : elementCounts) {
+        if (elementCount > maxElementCount) {
+            qDebug("%7u elements | skipped, exceeds the upload chunk (%u elements)\n", elementCount, maxElementCount);
+            continue;
+        }
+        deviceLocalBuffer buffer(sizeof(glm::vec3) * elementCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+
+        //旧路径：整个带间隔的源数据写入暂存区，每个元素一个拷贝区域；与新路径一样在传输队列上拷贝并转移所有权
+        auto t0 = clock::now();
+        for (uint32_t r = 0; r < repeatCount; r++) {
+            stagingBuffer::BufferData_MainThread(vertices.data(), sizeof(vertex_interleaved) * elementCount);
+            auto& commandBuffer = graphicsBase::Plus().CommandBuffer_TransferQueue();
+            commandBuffer.Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+            std::vector<VkBufferCopy> regions(elementCount);
+            for (size_t i = 0; i < regions.size(); i++)
+                regions[i] = VkBufferCopy{ sizeof(vertex_interleaved) * i, sizeof(glm::vec3) * i, sizeof(glm::vec3) };
+            vkCmdCopyBuffer(commandBuffer, stagingBuffer::Buffer_MainThread(), buffer, elementCount, regions.data());
+            VkBufferMemoryBarrier barrier = {
+                VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER, nullptr,
+                VK_ACCESS_TRANSFER_WRITE_BIT, 0,
+                graphicsBase::Base().QueueFamilyIndex_Transfer(), graphicsBase::Base().QueueFamilyIndex_Graphics(),
+                buffer, 0, sizeof(glm::vec3) * elementCount
+            };
+            if (graphicsBase::Base().HasDedicatedTransferQueue())
+                vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                    0, nullptr, 1, &barrier, 0, nullptr);
+            commandBuffer.End();
+            graphicsBase::Plus().ExecuteCommandBuffer_Transfer(commandBuffer, barrier);
+        }
+        //新路径：打包到暂存区，一个拷贝区域（若缓冲区分配到了host visible的内存，则直接写入，不经暂存区）
+        auto t1 = clock::now();
+        for (uint32_t r = 0; r < repeatCount; r++)
+            buffer.TransferData(vertices.data(), elementCount, sizeof(glm::vec3), sizeof(vertex_interleaved), sizeof(glm::vec3));
+        auto t2 = clock::now();
+
+        //仅CPU侧打包：逐元素memcpy(...) vs CopyStridedElements(...)（12字节的元素每次重排4个，SSE2）
+        std::vector<glm::vec3> packed(elementCount);
+        for (uint32_t r = 0; r < repeatCount; r++)
+            for (size_t i = 0; i < elementCount; i++)
+                memcpy(&packed[i], &vertices[i].position, sizeof(glm::vec3));
+        auto t3 = clock::now();
+        for (uint32_t r = 0; r < repeatCount; r++)
+            CopyStridedElements(packed.data(), sizeof(glm::vec3), vertices.data(), sizeof(vertex_interleaved), sizeof(glm::vec3), elementCount);
+        auto t4 = clock::now();
+
+        auto Milliseconds = [&](clock::time_point begin, clock::time_point end) {
+            return std::chrono::duration<double, std::milli>(end - begin).count() / repeatCount;
+        };
+        qDebug("%7u elements | per-element regions: %8.3f ms | packed single region: %8.3f ms | CPU gather memcpy: %7.3f ms, CopyStridedElements: %7.3f ms\n",
+               elementCount, Milliseconds(t0, t1), Milliseconds(t1, t2), Milliseconds(t2, t3), Milliseconds(t3, t4));
     }
     TerminateWindow();
 
@@ -317,6 +642,217 @@ int main_076(int argc, char *argv[])
     return 0;
 }
 
+//网格优化的基准测试：合成的百万三角形网格，三角形乱序且每个三角形有自己的3个顶点（未经处理的三角形汤）
+//比较优化前后的顶点数、索引类型、缓冲区大小、ACMR（平均每个三角形的顶点缓存未命中次数）及上传耗时
+int main_benchmark_mesh_optimization(int argc, char *argv[])
+{
+    QCoreApplication a(argc,argv);
+
+    //set vulkan env
+    setupVulkanEnv();
+
+    if (!InitializeWindow({ 640, 480 }))
+        return -1;
+
+    struct vertex {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec2 texCoord;
+    };
+    //gridSize x gridSize个四边形，每个四边形两个三角形；180对应约6.5万个三角形（可用16位索引），708对应约100万个三角形
+    const uint32_t gridSizes[] = { 180, 708 };
+    using clock = std::chrono::steady_clock;
+    auto Milliseconds = [](clock::time_point begin, clock::time_point end) {
+        return std::chrono::duration<double, std::milli>(end - begin).count();
+    };
+    for (uint32_t gridSize : gridSizes) {
+        //生成三角形并打乱顺序
+        std::vector<glm::uvec3> triangles;
+        triangles.reserve(size_t(gridSize) * gridSize * 2);
+        for (uint32_t y = 0; y < gridSize; y++)
+            for (uint32_t x = 0; x < gridSize; x++) {
+                uint32_t v0 = y * (gridSize + 1) + x, v1 = v0 + 1, v2 = v0 + gridSize + 1, v3 = v2 + 1;
+                triangles.push_back({ v0, v1, v2 });
+                triangles.push_back({ v1, v3, v2 });
+            }
+        std::shuffle(triangles.begin(), triangles.end(), std::mt19937(2024));
+        std::vector<vertex> vertices;
+        std::vector<uint32_t> indices;
+        vertices.reserve(triangles.size() * 3);
+        indices.reserve(triangles.size() * 3);
+        for (auto& triangle : triangles)
+            for (glm::length_t i = 0; i < 3; i++) {
+                glm::vec2 position(triangle[i] % (gridSize + 1), triangle[i] / (gridSize + 1));
+                indices.push_back(uint32_t(vertices.size()));
+                vertices.push_back({ glm::vec3(position, 0.f), glm::vec3(0.f, 0.f, 1.f), position / float(gridSize) });
+            }
+
+        //各阶段单独计时
+        auto t0 = clock::now();
+        meshData mesh_deduplicated = OptimizeMesh(vertices.data(), vertices.size(), sizeof(vertex), indices.data(), indices.size(), MESH_OPTIMIZE_DEDUPLICATE_VERTICES);
+        auto t1 = clock::now();
+        std::vector<uint32_t> indices_cacheOptimized(indices.size());
+        OptimizeVertexCache(indices_cacheOptimized.data(), mesh_deduplicated.indices.data(), indices.size(), mesh_deduplicated.VertexCount());
+        auto t2 = clock::now();
+        meshData mesh = OptimizeMesh(vertices.data(), vertices.size(), sizeof(vertex), indices.data(), indices.size());
+        auto t3 = clock::now();
+
+        //上传：原始数据 vs 优化后的数据（含16位索引的转换）
+        vertexBuffer vertexBuffer_raw(sizeof(vertex) * vertices.size());
+        indexBuffer indexBuffer_raw;
+        auto t4 = clock::now();
+        vertexBuffer_raw.TransferData(vertices.data(), sizeof(vertex) * vertices.size());
+        indexBuffer_raw.TransferIndices(indices.data(), uint32_t(indices.size()), uint32_t(vertices.size()));
+        auto t5 = clock::now();
+        vertexBuffer vertexBuffer_optimized(mesh.vertices.size());
+        indexBuffer indexBuffer_optimized;
+        auto t6 = clock::now();
+        vertexBuffer_optimized.TransferData(mesh.vertices.data(), mesh.vertices.size());
+        indexBuffer_optimized.TransferIndices(mesh);
+        auto t7 = clock::now();
+
+        auto IndexSize = [](const indexBuffer& buffer) {
+            return buffer.IndexType() == VK_INDEX_TYPE_UINT16 ? 2u : 4u;
+        };
+        qDebug("%7llu triangles\n"
+               "  raw       | vertices: %8llu (%7.2f MB) | indices: %u-bit (%7.2f MB) | ACMR: %.3f | upload: %8.3f ms\n"
+               "  optimized | vertices: %8u (%7.2f MB) | indices: %u-bit (%7.2f MB) | ACMR: %.3f | upload: %8.3f ms\n"
+               "  CPU: deduplicate %8.3f ms, vertex cache %8.3f ms, all passes %8.3f ms | ACMR after deduplication only: %.3f\n",
+               (unsigned long long)triangles.size(),
+               (unsigned long long)vertices.size(), sizeof(vertex) * vertices.size() / 1048576.0,
+               IndexSize(indexBuffer_raw) * 8, IndexSize(indexBuffer_raw) * indices.size() / 1048576.0,
+               AverageCacheMissRatio(indices.data(), indices.size(), vertices.size()), Milliseconds(t4, t5),
+               mesh.VertexCount(), mesh.vertices.size() / 1048576.0,
+               IndexSize(indexBuffer_optimized) * 8, IndexSize(indexBuffer_optimized) * mesh.indices.size() / 1048576.0,
+               AverageCacheMissRatio(mesh.indices.data(), mesh.indices.size(), mesh.VertexCount()), Milliseconds(t6, t7),
+               Milliseconds(t0, t1), Milliseconds(t1, t2), Milliseconds(t2, t3),
+               AverageCacheMissRatio(mesh_deduplicated.indices.data(), indices.size(), mesh_deduplicated.VertexCount()));
+    }
+    TerminateWindow();
+
+    a.quit();
+    return 0;
+}
+
+//gpuVector的正确性测试：随机Append(...)和Erase(...)，与std::vector对照，每步回读GPU上的元素并比较
+//Erase(...)的各条路径都会走到：尾部不长于被删除部分、借用空闲的容量、容量不足时经临时缓冲区中转
+int main_gpu_vector(int argc, char *argv[])
+{
+    QCoreApplication a(argc,argv);
+
+    //set vulkan env
+    setupVulkanEnv();
+
+    if (!InitializeWindow({ 640, 480 }))
+        return -1;
+
+    const uint32_t stepCount = 500;
+    const size_t maxSize = 4096;
+    gpuVector<uint32_t> vector_gpu(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    std::vector<uint32_t> vector_cpu;
+    readbackRing readback(sizeof(uint32_t) * maxSize * 2, 1);
+    std::mt19937 random(2024);
+    uint32_t nextValue = 0;
+    uint32_t mismatchCount = 0;
+    for (uint32_t step = 0; step < stepCount; step++) {
+        //没有frameContext推进deferredDestructionQueue，扩张时移入其中的旧缓冲区由这里回收
+        //gpuVector的各操作和回读都会等待执行完毕，此时之前步骤的命令都已完成
+        deferredDestructionQueue::Get().NextFrame();
+        //元素较少时多追加，接近maxSize时多删除
+        if (random() % maxSize >= vector_cpu.size()) {
+            std::vector<uint32_t> elements(random() % 256 + 1);
+            for (auto& i : elements)
+                i = nextValue++;
+            vector_gpu.Append(elements.data(), elements.size());
+            vector_cpu.insert(vector_cpu.end(), elements.begin(), elements.end());
+        }
+        else {
+            size_t index = random() % vector_cpu.size();
+            size_t eraseCount = random() % std::min(vector_cpu.size() - index, size_t(64)) + 1;
+            vector_gpu.Erase(index, eraseCount);
+            vector_cpu.erase(vector_cpu.begin() + index, vector_cpu.begin() + index + eraseCount);
+        }
+        if (vector_gpu.Size() != vector_cpu.size()) {
+            qDebug("step %u | size mismatch: %llu on GPU, %llu on CPU\n",
+                   step, (unsigned long long)vector_gpu.Size(), (unsigned long long)vector_cpu.size());
+            mismatchCount++;
+            continue;
+        }
+        if (vector_cpu.empty())
+            continue;
+        readback.CopyBuffer(vector_gpu, vector_gpu.SizeInBytes(), 0, [&](const void* pData, VkDeviceSize size) {
+            if (memcmp(pData, vector_cpu.data(), size_t(size)))
+                qDebug("step %u | content mismatch, size: %llu, capacity: %llu\n",
+                       step, (unsigned long long)vector_gpu.Size(), (unsigned long long)vector_gpu.Capacity()),
+                mismatchCount++;
+        });
+        readback.WaitAll();
+    }
+    qDebug("%u steps | final size: %llu, capacity: %llu | mismatches: %u\n",
+           stepCount, (unsigned long long)vector_gpu.Size(), (unsigned long long)vector_gpu.Capacity(), mismatchCount);
+    TerminateWindow();
+
+    a.quit();
+    return 0;
+}
+
+//bufferScatter的正确性测试：每轮向storage缓冲区中随机的位置分散写入vec4，其中一部分记录故意使用相同的目标偏移
+//与CPU端的副本（同一偏移以后写入的为准）对照，每轮回读整个缓冲区并比较
+int main_buffer_scatter(int argc, char *argv[])
+{
+    QCoreApplication a(argc,argv);
+
+    //set vulkan env
+    setupVulkanEnv();
+
+    if (!InitializeWindow({ 640, 480 }))
+        return -1;
+
+    const uint32_t elementCount = 65536;
+    const uint32_t recordCountPerRound = 4096;
+    const uint32_t roundCount = 50;
+    storageBuffer buffer_dst(sizeof(glm::vec4) * elementCount, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    std::vector<glm::vec4> elements(elementCount);
+    buffer_dst.TransferData(elements.data(), sizeof(glm::vec4) * elementCount);
+    //每轮的记录在一帧的段中，每轮执行完毕后才开始下一轮，一段就够
+    bufferScatter scatter((sizeof(uint32_t) + sizeof(glm::vec4)) * recordCountPerRound, 1);
+    readbackRing readback(sizeof(glm::vec4) * elementCount, 1);
+    std::mt19937 random(2024);
+    uint32_t mismatchCount = 0;
+    std::vector<uint32_t> usedIndices;
+    for (uint32_t round = 0; round < roundCount; round++) {
+        usedIndices.clear();
+        for (uint32_t i = 0; i < recordCountPerRound; i++) {
+            //约1/8的记录写入本轮之前用过的偏移
+            uint32_t index = random() % 8 || usedIndices.empty() ? random() % elementCount : usedIndices[random() % usedIndices.size()];
+            usedIndices.push_back(index);
+            glm::vec4 value(float(round), float(i), float(index), 1.f);
+            scatter.Add(sizeof(glm::vec4) * index, value);
+            elements[index] = value;
+        }
+        auto& commandBuffer = graphicsBase::Plus().CommandBuffer_Transfer();
+        commandBuffer.Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        bool recorded = scatter.CmdScatter(commandBuffer, buffer_dst, sizeof(glm::vec4) * elementCount,
+                                           VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+                                           VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+        commandBuffer.End();
+        if (!recorded)
+            break;
+        graphicsBase::Plus().ExecuteCommandBuffer_Graphics(commandBuffer);
+        scatter.NextFrame();
+        readback.CopyBuffer(buffer_dst, sizeof(glm::vec4) * elementCount, 0, [&](const void* pData, VkDeviceSize size) {
+            if (memcmp(pData, elements.data(), size_t(size)))
+                qDebug("round %u | content mismatch\n", round),
+                mismatchCount++;
+        });
+        readback.WaitAll();
+    }
+    qDebug("%u rounds of %u records | mismatches: %u\n", roundCount, recordCountPerRound, mismatchCount);
+    TerminateWindow();
+
+    a.quit();
+    return 0;
+}
 
 #include "Examples/Samples2DCompute.h"
 int main/*Samples2DCompute*/(int argc, char *argv[])
@@ -334,52 +870,38 @@ int main/*Samples2DCompute*/(int argc, char *argv[])
     Samples2DCmp samples2d_cmp;
     samples2d_cmp.initResource(ImagePath);
 
-    //1. 交换链获取GPU可用图像CMD，需知道CMD执行是否完成需要指定信号
-    semaphore semaphore_available; //需要知道交换链是否给GPU分配了可以使用图像
-
-    /*创建录制命令 -- 创建录制命令，需要有命令池，创建命令池需要缓冲区*/
-    //1.开始创建命令缓冲区(作用:渲染，从Graphics创建命令缓冲池)
-    commandBuffer command_buffer;
-    graphicsBase::Plus().CommandPool_Graphics().AllocateBuffers(command_buffer);
+    /*帧上下文 -- 同时处理2帧，每帧有各自的命令池、命令缓冲区、栅栏，以及获取图像和渲染结束两个信号量*/
+    //CPU录制下一帧时GPU仍可执行当前帧，只在轮到同一帧的资源时等待其栅栏
+    frameContext frames(2);
     while (!glfwWindowShouldClose(pWindow)) {
         //窗口最小化时停止渲染循环
         while (glfwGetWindowAttrib(pWindow, GLFW_ICONIFIED)){
             glfwWaitEvents();
         }
-        //提交从交换链获取GPU可用图像CMD
-        graphicsBase::Base().SwapImage(semaphore_available);
-        //录制命令(预留)
+        //等待该帧上一次提交的命令执行完毕，整体重置其命令池，并获取交换链图像
+        if (frames.BeginFrame())
+            continue;
+        //录制命令
+        const commandBuffer& command_buffer = frames.CommandBuffer();
         command_buffer.Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
         samples2d_cmp.runDispatch(command_buffer);
         command_buffer.End();
 
-        /*提交录制命令 -- 提交后有两种方式可以获得命令是否已经执行结束(GPU侧:信号,CPU侧:栅栏)*/
-        //1. 使用CPU侧同步，创建栅栏(fence)
-        fence fence_sync_flag;
-
-        //2. 提交录制命令前必须确保GPU已经从GPU拿到可用的图像(需要等待semaphore_available信号<由GPU完成同步>)
-        VkPipelineStageFlags waitDstStage = VK_PIPELINE_STAGE_TRANSFER_BIT; //拷贝和blit属于传输命令
-        VkSubmitInfo submit_info = {};
-        submit_info.waitSemaphoreCount = 1;
-        submit_info.pWaitSemaphores = semaphore_available.Address(); //指定执行命令前需要信号
-        submit_info.commandBufferCount = 1;
-        submit_info.pCommandBuffers = command_buffer.Address();//指定执行的命令缓冲
-        submit_info.pWaitDstStageMask = &waitDstStage;
-        graphicsBase::Base().SubmitCommandBuffer_Graphics(submit_info,fence_sync_flag);//命令缓冲执行结束后输出状态
-
-        /*提交呈现命令 -- 提交呈现命令前提是命令缓冲区已经执行结束(CPU测需要等待fence,GPU测需要等待渲染结束信号量<在submit输出可以指定>)*/
-        //1. 等待命令缓冲执行结束
-        fence_sync_flag.WaitAndReset();
-        //2. 呈现图像并向交换链归还使用完毕的图像
-        graphicsBase::Base().PresentImage();
+        /*提交录制命令并呈现 -- 提交前GPU须等待图像可用（拷贝和blit属于传输命令），呈现前等待渲染结束信号量，CPU不等待栅栏*/
+        frames.EndFrame(VK_PIPELINE_STAGE_TRANSFER_BIT);
+        //异步回读计算结果，回调在之后的帧中执行
+        samples2d_cmp.readbackResult([](const void* pData, VkDeviceSize /*size*/) {
+            static uint32_t resultCount = 0;
+            if (resultCount++ % 600 == 0) {
+                const uint8_t* pPixel = static_cast<const uint8_t*>(pData);
+                qDebug("Readback #%u, first pixel: %u %u %u %u\n", resultCount, pPixel[0], pPixel[1], pPixel[2], pPixel[3]);
+            }
+        });
 
         glfwPollEvents();
         TitleFps();
     }
 
-    /*释放命令缓冲*/
-    graphicsBase::Plus().CommandPool_Graphics().FreeBuffers(command_buffer);
-
     //关闭窗口
     TerminateWindow();
 
@@ -469,8 +991,11 @@ void EndSingleTimeCommands(VkDevice device, VkCommandPool commandPool, VkQueue q
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
 
+    //其他线程可能同时在该队列上提交
+    std::unique_lock<std::mutex> lock = graphicsBase::Base().LockQueue(queue);
     vkQueueSubmit(queue, 1, &submitInfo, (VkFence)VK_NULL_HANDLE);
     vkQueueWaitIdle(queue);
+    lock.unlock();
 
     vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 }